@@ -11,8 +11,10 @@ layout(location = 0) in vec3 world_pos;
 layout(location = 1) in float grid_size;
 
 #define PI 3.1415
-#define AXIS
-#define ARROWS
+
+// grid::variant_bits, arrows are only drawn with the axis
+layout(constant_id = 0) const bool AXIS = true;
+layout(constant_id = 1) const bool ARROWS = true;
 
 void main()
 {
@@ -42,7 +44,9 @@ void main()
     const float alpha = (1. - pow(distance_to_camera/grid_size, 3.0)) * length(color);
     out_color = vec4(color, alpha);
 
-    #ifdef AXIS
+    if (!AXIS)
+        return;
+
     const vec3 red = vec3(1.0, 0.0, 0.0);
     const vec3 blue = vec3(0.0, 0.0, 1.0);
     float length_yz = length(world_pos * vec3(0., 1., 1.));
@@ -74,7 +78,9 @@ void main()
         out_color = mix(blue_line, out_color, s);
     }
 
-    #ifdef ARROWS
+    if (!ARROWS)
+        return;
+
     if (world_pos.x > 0.75 && world_pos.x < 1.0 && world_pos.z > -0.25 && world_pos.z < 0.25)
     {
         float z1 = world_pos.x - 1.f;
@@ -93,6 +99,4 @@ void main()
         if (delta1 > 0. && delta2 > 0.)
             out_color = vec4(0., 0., 1., 1.);
     }
-    #endif
-    #endif
 }
@@ -5,10 +5,24 @@ layout(location = 1) in vec3 normal;
 layout(location = 2) in vec3 world_pos;
 layout(location = 0) out vec4 out_color;
 
+// clustering::grid_* and clustering::max_lights_per_cluster, same in light_clusters.comp
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 63
+
+// cone::variant_bits, a zero max leaves the loop out of the variant entirely
+layout(constant_id = 0) const uint MAX_DIRECTIONAL_LIGHTS = 4;
+layout(constant_id = 1) const uint MAX_POINT_LIGHTS = MAX_LIGHTS_PER_CLUSTER;
+layout(constant_id = 2) const bool SPECULAR = true;
+
 layout(set = 0, binding = 0) uniform CameraData
 {
     vec4 position;
     mat4 projview;
+    // clustering::fragment_lookup
+    vec4 depth_plane;
+    vec4 cluster_scale;
 } camera_data;
 
 struct DirectionalLight
@@ -41,6 +55,18 @@ layout(set = 0, binding = 3) readonly buffer PointLightsData
     PointLight point_lights[];
 };
 
+struct Cluster
+{
+    uint count;
+    uint lights[MAX_LIGHTS_PER_CLUSTER];
+};
+
+// point lights reaching each froxel, written by light_clusters.comp
+layout(set = 0, binding = 6) readonly buffer ClustersData
+{
+    Cluster clusters[];
+};
+
 vec3 directional_lights_part(vec3 view_dir);
 vec3 point_lights_part(vec3 view_dir);
 
@@ -61,42 +87,63 @@ vec3 directional_lights_part(vec3 view_dir)
     vec3 diffuse = vec3(0);
     vec3 specular = vec3(0);
 
-    for (int i = 0; i < directional_lights.length(); ++i)
+    const uint count = min(uint(directional_lights.length()), MAX_DIRECTIONAL_LIGHTS);
+    for (uint i = 0; i < count; ++i)
     {
         DirectionalLight light = directional_lights[i];
         vec3 dir = -normalize(light.direction.xyz);
         float diffuse_scale = max(dot(normal, dir), 0.0);
-        vec3 reflected_dir = reflect(-dir, normal);
-        float specular_scale = pow(max(dot(view_dir, reflected_dir), 0.0), 32); // 32 is material shininess
 
         ambient += light.ambient.xyz;
         diffuse += light.diffuse.xyz * diffuse_scale;
-        specular += light.specular.xyz * specular_scale;
+        if (SPECULAR)
+        {
+            vec3 reflected_dir = reflect(-dir, normal);
+            float specular_scale = pow(max(dot(view_dir, reflected_dir), 0.0), 32); // 32 is material shininess
+            specular += light.specular.xyz * specular_scale;
+        }
     }
 
     return (ambient + diffuse + specular);
 }
 
+uint cluster_index()
+{
+    const float depth = dot(camera_data.depth_plane, vec4(world_pos, 1.0));
+    const uint slice = uint(clamp(log(depth) * camera_data.cluster_scale.z + camera_data.cluster_scale.w, 0.0, CLUSTER_GRID_Z - 1));
+    const uvec2 tile = min(uvec2(gl_FragCoord.xy * camera_data.cluster_scale.xy), uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+    return tile.x + tile.y * CLUSTER_GRID_X + slice * CLUSTER_GRID_X * CLUSTER_GRID_Y;
+}
+
 vec3 point_lights_part(vec3 view_dir)
 {
     vec3 ambient = vec3(0);
     vec3 diffuse = vec3(0);
     vec3 specular = vec3(0);
 
-    for (int i = 0; i < point_lights.length(); ++i)
+    if (MAX_POINT_LIGHTS == 0)
+        return vec3(0);
+
+    // only the lights whose attenuation radius reaches this fragment's cluster
+    const uint cluster = cluster_index();
+    const uint count = min(clusters[cluster].count, MAX_POINT_LIGHTS);
+    for (uint i = 0; i < count; ++i)
     {
-        PointLight light = point_lights[i];
+        PointLight light = point_lights[clusters[cluster].lights[i]];
         float dist = length(light.position.xyz - world_pos);
         float attenuation = 1.0 / (light.constant + light.linear * dist + light.quadratic * dist * dist);
 
         vec3 dir = -normalize(world_pos - light.position.xyz);
         float diffuse_scale = max(dot(normal, dir), 0.0);
-        vec3 reflected_dir = reflect(-dir, normal);
-        float specular_scale = pow(max(dot(view_dir, reflected_dir), 0.0), 32); // 32 is material shininess
 
         ambient += light.ambient.xyz * attenuation;
         diffuse += light.diffuse.xyz * diffuse_scale * attenuation;
-        specular += light.specular.xyz * specular_scale * attenuation;
+        if (SPECULAR)
+        {
+            vec3 reflected_dir = reflect(-dir, normal);
+            float specular_scale = pow(max(dot(view_dir, reflected_dir), 0.0), 32); // 32 is material shininess
+            specular += light.specular.xyz * specular_scale * attenuation;
+        }
     }
 
     return (ambient + diffuse + specular);
@@ -1,7 +1,8 @@
 #version 450
 
-layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 normal;
+// cone::vertex_input_state, half float position with w = 1 and an octahedral normal
+layout(location = 0) in vec4 pos;
+layout(location = 1) in vec2 packed_normal;
 
 layout(location = 0) out vec4 object_color;
 layout(location = 1) out vec3 out_normal;
@@ -13,13 +14,13 @@ layout(set = 0, binding = 0) uniform CameraData
     mat4 projview;
 } camera_data;
 
+// boids::instance
 struct ConeInstance
 {
-    vec4 position;
-    vec4 direction;
-    vec4 velocity;
-    vec4 color;
-    mat4 model_matrix;
+    vec3 position;
+    float scale;
+    vec3 direction;
+    uint color;
 };
 
 layout(set = 0, binding = 1) readonly buffer ModelData
@@ -27,10 +28,72 @@ layout(set = 0, binding = 1) readonly buffer ModelData
     ConeInstance cones[];
 } model;
 
+// state before the last simulation tick, same as ModelData when the cpu interpolated already
+layout(set = 0, binding = 4) readonly buffer PreviousModelData
+{
+    ConeInstance cones[];
+} previous_model;
+
+// indices of the boids cull.comp found inside the frustum, gl_InstanceIndex counts visible boids only
+layout(set = 0, binding = 5) readonly buffer VisibleInstances
+{
+    uint indices[];
+} visible;
+
+// offset 0 is the aquarium scale
+layout(push_constant) uniform constants
+{
+    layout(offset = 4) float interpolation;
+} push_constants;
+
+// glm::rotation(vec3(0, 1, 0), direction) turned into a matrix
+mat3 rotation_from_up(vec3 direction)
+{
+    const float epsilon = 1.1920929e-7;
+    const float cos_theta = direction.y;
+
+    vec4 q = vec4(0, 0, 0, 1);
+    if (cos_theta < -1 + epsilon)
+    {
+        q = vec4(-1, 0, 0, 0);
+    }
+    else if (cos_theta < 1 - epsilon)
+    {
+        const float s = sqrt((1 + cos_theta) * 2);
+        q = vec4(cross(vec3(0, 1, 0), direction) / s, s * 0.5);
+    }
+
+    return mat3(
+        1 - 2 * (q.y * q.y + q.z * q.z), 2 * (q.x * q.y + q.w * q.z), 2 * (q.x * q.z - q.w * q.y),
+        2 * (q.x * q.y - q.w * q.z), 1 - 2 * (q.x * q.x + q.z * q.z), 2 * (q.y * q.z + q.w * q.x),
+        2 * (q.x * q.z + q.w * q.y), 2 * (q.y * q.z - q.w * q.x), 1 - 2 * (q.x * q.x + q.y * q.y));
+}
+
+// mesh::octahedral_encode
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    const float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
 void main() {
-    vec4 world_pos = model.cones[gl_InstanceIndex].model_matrix * vec4(pos, 1.0);
-    gl_Position = camera_data.projview * world_pos;
-    object_color = model.cones[gl_InstanceIndex].color;
-    out_normal = normalize(mat3(transpose(inverse(model.cones[gl_InstanceIndex].model_matrix))) * normal);
-    out_world_pos = world_pos.xyz;
+    const uint index = visible.indices[gl_InstanceIndex];
+    const ConeInstance cone = model.cones[index];
+    const ConeInstance previous_cone = previous_model.cones[index];
+
+    // a reflection can turn a boid around completely, there is no direction half way
+    vec3 direction = mix(previous_cone.direction, cone.direction, push_constants.interpolation);
+    if (dot(direction, direction) == 0)
+        direction = cone.direction;
+
+    // scale is uniform, so the rotation is also the normal matrix
+    const mat3 rotation = rotation_from_up(normalize(direction));
+    const vec3 world_pos = rotation * (pos.xyz * cone.scale) + mix(previous_cone.position, cone.position, push_constants.interpolation);
+
+    gl_Position = camera_data.projview * vec4(world_pos, 1.0);
+    object_color = unpackUnorm4x8(cone.color);
+    out_normal = normalize(rotation * octahedral_decode(packed_normal));
+    out_world_pos = world_pos;
 }
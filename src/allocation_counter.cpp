@@ -0,0 +1,74 @@
+#include "allocation_counter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Only the plain and aligned versions are replaced, the default nothrow and array ones forward to them. Sized deletes forward here explicitly, compilers warn when they're left out
+namespace
+{
+    std::atomic<uint64_t> allocations = 0;
+}
+
+namespace memory
+{
+    uint64_t allocation_count()
+    {
+        return allocations.load(std::memory_order_relaxed);
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants the size to be a multiple of the alignment
+    const auto aligned_size = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+#ifdef _MSC_VER
+    auto* p = _aligned_malloc(aligned_size, align);
+#else
+    auto* p = std::aligned_alloc(align, aligned_size);
+#endif
+    if (p)
+    {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// Linking allocation_counter.cpp replaces the global operator new/delete with ones that count every allocation, on every thread.
+// Meant for the bench, which checks that a simulation tick doesn't touch the heap once the flock stopped growing.
+namespace memory
+{
+    uint64_t allocation_count();
+}
@@ -1,52 +1,13 @@
 #include "aquarium.hpp"
-#include "constants.hpp"
+#include "setup.hpp"
 #include "shaders/shaders.h"
 
 #include <glm/glm.hpp>
 
+#include <array>
+
 namespace aquarium
 {
-    struct
-    {
-        glm::vec3 front = glm::vec3(0, 0, -1);
-        glm::vec3 back = glm::vec3(0, 0, 1);
-        glm::vec3 top = glm::vec3(0, -1, 0);
-        glm::vec3 bottom = glm::vec3(0, 1, 0);
-        glm::vec3 left = glm::vec3(1, 0, 0);
-        glm::vec3 right = glm::vec3(-1, 0, 0);
-    } const inward_faces_normals;
-
-    std::array<boids::plane_repellent, 6> get_wall_repellents(const glm::vec3& min_range, const glm::vec3& max_range, float& force_weight)
-    {
-        return std::array{
-            boids::plane_repellent(inward_faces_normals.front, max_range.z, force_weight),
-            boids::plane_repellent(inward_faces_normals.back, min_range.z, force_weight),
-            boids::plane_repellent(inward_faces_normals.top, max_range.y, force_weight),
-            boids::plane_repellent(inward_faces_normals.bottom, min_range.y, force_weight),
-            boids::plane_repellent(inward_faces_normals.right, max_range.x, force_weight),
-            boids::plane_repellent(inward_faces_normals.left, min_range.x, force_weight),
-        };
-
-    }
-
-    std::tuple<bool, const glm::vec3&> check_collision(const glm::vec4& pos, const glm::vec3& min_range, const glm::vec3& max_range)
-    {
-        if (pos.x < min_range.x)
-            return { true, inward_faces_normals.left };
-        else if (pos.x > max_range.x)
-            return { true, inward_faces_normals.right };
-        else if (pos.y < min_range.y)
-            return { true, inward_faces_normals.bottom };
-        else if (pos.y > max_range.y)
-            return { true, inward_faces_normals.top };
-        else if (pos.z < min_range.z)
-            return { true, inward_faces_normals.back };
-        else if (pos.z > max_range.z)
-            return { true, inward_faces_normals.front };
-
-        return { false, {} };
-    }
-
     constexpr auto vertex_input_state = VkPipelineVertexInputStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
         .pNext = nullptr,
@@ -65,31 +26,25 @@ namespace aquarium
         .primitiveRestartEnable = VK_FALSE
     };
 
-    auto viewport = VkViewport{
-        .x = 0.f,
-        .y = 0.f,
-        .width = 0.f,
-        .height = 0.f,
-        .minDepth = 0.f,
-        .maxDepth = 1.f
-    };
-
-    auto scissors = VkRect2D{
-        .offset = VkOffset2D{
-            .x = 0,
-            .y = 0,
-        },
-        .extent = {}
-    };
-
     const auto viewport_state = VkPipelineViewportStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
         .viewportCount = 1,
-        .pViewports = &viewport,
+        .pViewports = nullptr, // dynamic
         .scissorCount = 1,
-        .pScissors = &scissors,
+        .pScissors = nullptr, // dynamic
+    };
+
+    // set every frame, resizing doesn't touch the pipeline
+    constexpr auto dynamic_states = std::array{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    const auto dynamic_state = VkPipelineDynamicStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+        .pDynamicStates = dynamic_states.data()
     };
 
     constexpr auto rasterization_state = VkPipelineRasterizationStateCreateInfo{
@@ -108,18 +63,6 @@ namespace aquarium
         .lineWidth = 10.f
     };
 
-    constexpr auto multisample_state = VkPipelineMultisampleStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .rasterizationSamples = msaa_samples,
-        .sampleShadingEnable = VK_FALSE,
-        .minSampleShading = 1.f,
-        .pSampleMask = nullptr,
-        .alphaToCoverageEnable = VK_FALSE,
-        .alphaToOneEnable = VK_FALSE
-    };
-
     constexpr auto depth_stencil_state = VkPipelineDepthStencilStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
         .pNext = nullptr,
@@ -157,7 +100,7 @@ namespace aquarium
         .blendConstants = {0.f, 0.f, 0.f, 0.f}
     };
 
-    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, const VkExtent2D& window_extent, shaders::module_cache& shaders_cache)
+    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkSampleCountFlagBits samples, shaders::module_cache& shaders_cache)
     {
         static const auto shader_stages = std::array{
             VkPipelineShaderStageCreateInfo{
@@ -180,11 +123,6 @@ namespace aquarium
             }
         };
 
-        viewport.width = window_extent.width;
-        viewport.height = window_extent.height;
-
-        scissors.extent = window_extent;
-
         const auto create_info = VkGraphicsPipelineCreateInfo{
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
             .pNext = nullptr,
@@ -196,10 +134,10 @@ namespace aquarium
             .pTessellationState = nullptr,
             .pViewportState = &viewport_state,
             .pRasterizationState = &rasterization_state,
-            .pMultisampleState = &multisample_state,
+            .pMultisampleState = &get_multisample_state(samples),
             .pDepthStencilState = &depth_stencil_state,
             .pColorBlendState = &color_blend_state,
-            .pDynamicState = nullptr,
+            .pDynamicState = &dynamic_state,
             .layout = pipeline_layout,
             .renderPass = render_pass,
             .subpass = 0,
@@ -0,0 +1,45 @@
+#include "aquarium_bounds.hpp"
+
+namespace aquarium
+{
+    struct
+    {
+        glm::vec3 front = glm::vec3(0, 0, -1);
+        glm::vec3 back = glm::vec3(0, 0, 1);
+        glm::vec3 top = glm::vec3(0, -1, 0);
+        glm::vec3 bottom = glm::vec3(0, 1, 0);
+        glm::vec3 left = glm::vec3(1, 0, 0);
+        glm::vec3 right = glm::vec3(-1, 0, 0);
+    } const inward_faces_normals;
+
+    std::array<boids::plane_repellent, 6> get_wall_repellents(const glm::vec3& min_range, const glm::vec3& max_range, float& force_weight)
+    {
+        return std::array{
+            boids::plane_repellent(inward_faces_normals.front, max_range.z, force_weight),
+            boids::plane_repellent(inward_faces_normals.back, min_range.z, force_weight),
+            boids::plane_repellent(inward_faces_normals.top, max_range.y, force_weight),
+            boids::plane_repellent(inward_faces_normals.bottom, min_range.y, force_weight),
+            boids::plane_repellent(inward_faces_normals.right, max_range.x, force_weight),
+            boids::plane_repellent(inward_faces_normals.left, min_range.x, force_weight),
+        };
+
+    }
+
+    std::tuple<bool, const glm::vec3&> check_collision(const glm::vec4& pos, const glm::vec3& min_range, const glm::vec3& max_range)
+    {
+        if (pos.x < min_range.x)
+            return { true, inward_faces_normals.left };
+        else if (pos.x > max_range.x)
+            return { true, inward_faces_normals.right };
+        else if (pos.y < min_range.y)
+            return { true, inward_faces_normals.bottom };
+        else if (pos.y > max_range.y)
+            return { true, inward_faces_normals.top };
+        else if (pos.z < min_range.z)
+            return { true, inward_faces_normals.back };
+        else if (pos.z > max_range.z)
+            return { true, inward_faces_normals.front };
+
+        return { false, {} };
+    }
+}
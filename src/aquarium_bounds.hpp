@@ -0,0 +1,19 @@
+#pragma once
+
+#include "boids.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <tuple>
+
+// Simulation side of the aquarium - no Vulkan in here, so it can be linked into the headless bench
+namespace aquarium
+{
+    constexpr float scale = 30.f;
+    inline const auto min_range = glm::vec3(-scale, 0.f, -scale);
+    inline const auto max_range = glm::vec3(scale, scale, scale);
+
+    std::tuple<bool, const glm::vec3&> check_collision(const glm::vec4& pos, const glm::vec3& min_range, const glm::vec3& max_range);
+    std::array<boids::plane_repellent, 6> get_wall_repellents(const glm::vec3& min_range, const glm::vec3& max_range, float& force_weight);
+}
@@ -0,0 +1,192 @@
+// Headless simulation benchmark - runs the same boids::step the app runs every frame, without a window or Vulkan.
+// Prints one JSON object to stdout, e.g. `boids_bench --boids 100000 --ticks 500 --threads 8`
+// Exits with 2 when the timed ticks allocated, a tick of a constant size flock is expected to stay off the heap.
+// `--validate` checks the fast paths against their reference versions on the flock after warmup instead of timing, and exits with 3 on a mismatch:
+// the spatial hash steer has to match the brute force one bit for bit, every simd kernel the cpu runs has to stay within kernel_tolerance of the scalar one.
+#include "allocation_counter.hpp"
+#include "aquarium_bounds.hpp"
+#include "cli.hpp"
+#include "flock.hpp"
+#include "steer_kernels.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // kernels only add up in a different order, this is a couple hundred float epsilons
+    constexpr auto kernel_tolerance = 1e-4f;
+
+    // The spatial hash boids::steer has to match the brute force one bit for bit. Returns how many boids don't.
+    std::size_t validate_steer(const boids::flock& flock, const boids::parameters& params)
+    {
+        auto all_boids = std::vector<boids::boid>(flock.size());
+        for (std::size_t i = 0; i < flock.size(); ++i)
+        {
+            all_boids[i].position = glm::vec4(flock.x[i], flock.y[i], flock.z[i], 0.f);
+            all_boids[i].velocity = glm::vec4(flock.vx[i], flock.vy[i], flock.vz[i], 0.f);
+        }
+        auto neighbours = boids::spatial_hash{};
+        neighbours.rebuild(all_boids, params.visual_range);
+
+        auto mismatches = std::size_t{ 0 };
+        for (std::size_t i = 0; i < all_boids.size(); ++i)
+        {
+            const auto expected = boids::steer(i, all_boids, params.visual_range, params.cohesion_weight, params.separation_weight, params.alignment_weight);
+            const auto actual = boids::steer(i, all_boids, neighbours, params.visual_range, params.cohesion_weight, params.separation_weight, params.alignment_weight);
+            if (std::memcmp(&expected, &actual, sizeof(expected)) != 0)
+            {
+                ++mismatches;
+            }
+        }
+        return mismatches;
+    }
+
+    struct kernel_error
+    {
+        boids::kernels::isa isa;
+        float max_error;
+    };
+
+    // Runs every kernel select() accepts over the sorted flock and compares each sum to the scalar kernel's, relative to it once it's above 1.
+    // Leaves the active kernel as it was.
+    std::vector<kernel_error> validate_kernels(const boids::sorted_flock& sorted, const boids::spatial_hash& neighbours, std::size_t count, float visual_range)
+    {
+        const auto flatten = [](const boids::kernels::neighbour_sums& s) { return std::array{ s.count, s.cx, s.cy, s.cz, s.sx, s.sy, s.sz, s.ax, s.ay, s.az }; };
+        const auto candidates = boids::kernels::candidates{ sorted.x.data(), sorted.y.data(), sorted.z.data(), sorted.vx.data(), sorted.vy.data(), sorted.vz.data() };
+        const auto selected = boids::kernels::active_isa();
+
+        auto errors = std::vector<kernel_error>{};
+        for (const auto isa : { boids::kernels::isa::sse2, boids::kernels::isa::avx2, boids::kernels::isa::neon })
+        {
+            if (!boids::kernels::select(isa))
+            {
+                continue;
+            }
+
+            const auto accumulate = boids::kernels::active();
+            auto max_error = 0.f;
+            for (std::size_t slot = 0; slot < count; ++slot)
+            {
+                const auto px = sorted.x[slot];
+                const auto py = sorted.y[slot];
+                const auto pz = sorted.z[slot];
+                auto ranges = std::array<boids::spatial_hash::range, boids::spatial_hash::max_query_buckets>{};
+                const auto candidate_ranges = neighbours.candidate_ranges({ px, py, pz }, visual_range, ranges);
+                const auto self = static_cast<uint32_t>(slot);
+
+                const auto expected = flatten(boids::kernels::accumulate_scalar(candidates, candidate_ranges.data(), candidate_ranges.size(), self, px, py, pz, visual_range * visual_range));
+                const auto actual = flatten(accumulate(candidates, candidate_ranges.data(), candidate_ranges.size(), self, px, py, pz, visual_range * visual_range));
+                for (std::size_t i = 0; i < expected.size(); ++i)
+                {
+                    max_error = std::max(max_error, std::abs(actual[i] - expected[i]) / std::max(1.f, std::abs(expected[i])));
+                }
+            }
+            errors.push_back({ isa, max_error });
+        }
+
+        boids::kernels::select(selected);
+        return errors;
+    }
+
+    // nearest rank
+    double percentile(const std::vector<double>& sorted, double p)
+    {
+        const auto rank = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const auto boids_count = static_cast<std::size_t>(cli::uint_option(argc, argv, "--boids", 10000));
+    const auto ticks = std::max<std::size_t>(cli::uint_option(argc, argv, "--ticks", 1000), 1);
+    const auto validate = cli::has_flag(argc, argv, "--validate");
+    // validation reads the sorted flock a tick leaves behind
+    const auto warmup_ticks = std::max<std::size_t>(cli::uint_option(argc, argv, "--warmup", 10), validate ? 1 : 0);
+    const auto threads = std::max<std::size_t>(cli::uint_option(argc, argv, "--threads", std::max(std::thread::hardware_concurrency(), 1u)), 1);
+    // same flock every run, so runs compare and validation failures reproduce
+    const auto seed = static_cast<uint32_t>(cli::uint_option(argc, argv, "--seed", 1));
+
+    if (const auto kernel_option = cli::find_option(argc, argv, "--kernel"))
+    {
+        const auto kernel = boids::kernels::from_name(*kernel_option);
+        if (!kernel || !boids::kernels::select(*kernel))
+        {
+            std::fprintf(stderr, "Steering kernel %.*s is not supported on this cpu.\n", static_cast<int>(kernel_option->size()), kernel_option->data());
+            return 1;
+        }
+    }
+
+    // same defaults as the app
+    auto wall_force_weight = cli::float_option(argc, argv, "--wall-force", 0.1f);
+    const auto params = boids::parameters{
+        .visual_range = cli::float_option(argc, argv, "--visual-range", 1.f),
+        .cohesion_weight = cli::float_option(argc, argv, "--cohesion", 0.001f),
+        .separation_weight = cli::float_option(argc, argv, "--separation", 0.001f),
+        .alignment_weight = cli::float_option(argc, argv, "--alignment", 0.001f),
+        .speed = cli::float_option(argc, argv, "--speed", 0.1f)
+    };
+    const auto wall_repellents = aquarium::get_wall_repellents(aquarium::min_range, aquarium::max_range, wall_force_weight);
+
+    auto pool = jobs::thread_pool(threads);
+    auto flock = boids::flock(boids_count);
+    auto sorted_flock = boids::sorted_flock{};
+    auto neighbours = boids::spatial_hash{};
+    boids::spawn(flock, aquarium::min_range, aquarium::max_range, 0, seed);
+
+    for (std::size_t i = 0; i < warmup_ticks; ++i)
+    {
+        boids::step(flock, sorted_flock, neighbours, params, wall_repellents, aquarium::min_range, aquarium::max_range, pool);
+    }
+
+    if (validate)
+    {
+        // sorted_flock and neighbours still hold the last warmup tick's input
+        const auto steer_mismatches = validate_steer(flock, params);
+        const auto kernel_errors = validate_kernels(sorted_flock, neighbours, boids_count, params.visual_range);
+
+        auto kernels_ok = true;
+        std::printf("{\"boids\": %zu, \"seed\": %u, \"visual_range\": %g, \"steer_mismatches\": %zu, \"kernel_tolerance\": %g, \"kernel_errors\": {", boids_count, seed, params.visual_range, steer_mismatches, kernel_tolerance);
+        for (std::size_t i = 0; i < kernel_errors.size(); ++i)
+        {
+            std::printf("%s\"%s\": %g", i ? ", " : "", boids::kernels::name(kernel_errors[i].isa), kernel_errors[i].max_error);
+            kernels_ok = kernels_ok && kernel_errors[i].max_error <= kernel_tolerance;
+        }
+        std::printf("}}\n");
+        return steer_mismatches == 0 && kernels_ok ? 0 : 3;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto tick_ns = std::vector<double>(ticks);
+    const auto start_allocations = memory::allocation_count();
+    const auto start = clock::now();
+    for (auto& duration : tick_ns)
+    {
+        const auto tick_start = clock::now();
+        boids::step(flock, sorted_flock, neighbours, params, wall_repellents, aquarium::min_range, aquarium::max_range, pool);
+        duration = std::chrono::duration<double, std::nano>(clock::now() - tick_start).count();
+    }
+    const auto total_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    const auto allocations = memory::allocation_count() - start_allocations;
+
+    std::sort(tick_ns.begin(), tick_ns.end());
+    // of the step calls alone like the percentiles, total_ns also has the loop and clock reads in it
+    const auto mean_ns = std::accumulate(tick_ns.begin(), tick_ns.end(), 0.) / ticks;
+
+    std::printf("{\"boids\": %zu, \"seed\": %u, \"ticks\": %zu, \"threads\": %zu, \"kernel\": \"%s\", \"visual_range\": %g, "
+        "\"ticks_per_second\": %.3f, \"ns_per_boid\": %.3f, \"tick_ns\": {\"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}, \"allocations\": %llu}\n",
+        boids_count, seed, ticks, threads, boids::kernels::name(boids::kernels::active_isa()), params.visual_range,
+        ticks * 1e9 / total_ns, boids_count ? total_ns / (static_cast<double>(ticks) * boids_count) : 0.,
+        mean_ns, percentile(tick_ns, 0.5), percentile(tick_ns, 0.99), tick_ns.back(), static_cast<unsigned long long>(allocations));
+
+    return allocations == 0 ? 0 : 2;
+}
@@ -1,7 +1,31 @@
 #include "boids.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
 namespace boids
 {
+    namespace
+    {
+        glm::vec4 combine(const glm::vec4& position, std::size_t observed_boids, glm::vec4 avg_observable_cluster_position, const glm::vec4& separation, glm::vec4 alignment, float cohesion_weight, float separation_weight, float alignment_weight)
+        {
+            if (observed_boids)
+            {
+                avg_observable_cluster_position /= observed_boids;
+                alignment /= observed_boids;
+                const auto total_cohesion = (avg_observable_cluster_position - position) * cohesion_weight;
+                const auto total_separation = separation * separation_weight;
+                const auto total_alignment = alignment * alignment_weight;
+                return total_cohesion + total_separation + total_alignment;
+            }
+            else
+            {
+                return glm::vec4(0);
+            }
+        }
+    }
+
     glm::vec4 steer(std::size_t index, const std::vector<boid>& boids, float visual_range, float cohesion_weight, float separation_weight, float alignment_weight)
     {
         assert(index < boids.size());
@@ -24,18 +48,40 @@ namespace boids
             }
         }
 
-        if (observed_boids)
-        {
-            avg_observable_cluster_position /= observed_boids;
-            alignment /= observed_boids;
-            const auto total_cohesion = (avg_observable_cluster_position - current_boid.position) * cohesion_weight;
-            const auto total_separation = separation * separation_weight;
-            const auto total_alignment = alignment * alignment_weight;
-            return total_cohesion + total_separation + total_alignment;
-        }
-        else
+        return combine(current_boid.position, observed_boids, avg_observable_cluster_position, separation, alignment, cohesion_weight, separation_weight, alignment_weight);
+    }
+
+    glm::vec4 steer(std::size_t index, const std::vector<boid>& boids, const spatial_hash& neighbours, float visual_range, float cohesion_weight, float separation_weight, float alignment_weight)
+    {
+        assert(index < boids.size());
+        const auto& current_boid = boids[index];
+
+        // reused between calls, so steady state doesn't allocate
+        thread_local auto observed = std::vector<std::pair<uint32_t, float>>{};
+        observed.clear();
+
+        neighbours.for_each_candidate(glm::vec3(current_boid.position), visual_range, [&](uint32_t i) {
+            const auto distance = glm::distance(current_boid.position, boids[i].position);
+            if (i != index && distance < visual_range)
+            {
+                observed.emplace_back(i, distance);
+            }
+        });
+
+        // float sums depend on order - accumulate in the same order as the brute force loop
+        std::sort(observed.begin(), observed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        auto avg_observable_cluster_position = glm::vec4(0);
+        auto separation = glm::vec4(0);
+        auto alignment = glm::vec4();
+        for (const auto& [i, distance] : observed)
         {
-            return glm::vec4(0);
+            const auto& boid = boids[i];
+            avg_observable_cluster_position += boid.position;
+            separation += (current_boid.position - boid.position) / glm::abs(distance);
+            alignment += boid.velocity;
         }
+
+        return combine(current_boid.position, observed.size(), avg_observable_cluster_position, separation, alignment, cohesion_weight, separation_weight, alignment_weight);
     }
-}
\ No newline at end of file
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "spatial_hash.hpp"
+
 #include <glm/glm.hpp>
 #include <glm/gtx/norm.hpp>
 
@@ -17,11 +19,18 @@ namespace boids
     };
 
     glm::vec4 steer(std::size_t index, const std::vector<boid>& boids, float visual_range, float cohesion_weight, float separation_weight, float alignment_weight);
+    // same result as above, bit for bit, but only looks at boids from neighbouring cells. neighbours has to be rebuilt from boids with cell size >= visual_range
+    glm::vec4 steer(std::size_t index, const std::vector<boid>& boids, const spatial_hash& neighbours, float visual_range, float cohesion_weight, float separation_weight, float alignment_weight);
 
     class repellent
     {
     public:
-        virtual glm::vec3 get_velocity_diff(const boid&) const = 0;
+        virtual glm::vec3 get_velocity_diff(const glm::vec3& boid_position) const = 0;
+
+        glm::vec3 get_velocity_diff(const boid& boid) const
+        {
+            return get_velocity_diff(glm::vec3(boid.position));
+        }
     };
 
     class plane_repellent final : public repellent
@@ -31,9 +40,10 @@ namespace boids
         {
         }
 
-        glm::vec3 get_velocity_diff(const boid& boid) const override
+        using repellent::get_velocity_diff;
+
+        glm::vec3 get_velocity_diff(const glm::vec3& boid_position) const override
         {
-            const auto boid_position = glm::vec3(boid.position);
             const auto v = boid_position - _normal * boid_position + _pos * _normal; // project boid onto plane
             const auto distance2 = glm::distance2(boid_position, v);
 
@@ -0,0 +1,182 @@
+#include "boids_compute.hpp"
+#include "vkcheck.hpp"
+
+#include <shaders/shaders.h>
+
+#include <array>
+
+namespace boids::compute
+{
+    // local_size_x in boids.comp
+    constexpr auto workgroup_size = uint32_t{ 64 };
+
+    VkDescriptorSetLayout create_descriptor_set_layout(VkDevice logical_device, cleanup::queue_type& cleanup_queue)
+    {
+        const auto bindings = std::array{
+            VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr
+            },
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr
+            },
+            VkDescriptorSetLayoutBinding{
+                .binding = 2,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr
+            },
+            VkDescriptorSetLayoutBinding{
+                .binding = 3,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr
+            }
+        };
+
+        const auto create_info = VkDescriptorSetLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .bindingCount = bindings.size(),
+            .pBindings = bindings.data()
+        };
+
+        auto layout = VkDescriptorSetLayout{};
+        VK_CHECK(vkCreateDescriptorSetLayout(logical_device, &create_info, nullptr, &layout));
+
+        cleanup_queue.push([logical_device, layout]() { vkDestroyDescriptorSetLayout(logical_device, layout, nullptr); });
+
+        return layout;
+    }
+
+    VkPipelineLayout create_pipeline_layout(VkDevice logical_device, VkDescriptorSetLayout set_layout, cleanup::queue_type& cleanup_queue)
+    {
+        const auto push_constant_range = VkPushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(push_constants)
+        };
+
+        const auto create_info = VkPipelineLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .setLayoutCount = 1,
+            .pSetLayouts = &set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_constant_range
+        };
+
+        auto pipeline_layout = VkPipelineLayout{};
+        VK_CHECK(vkCreatePipelineLayout(logical_device, &create_info, nullptr, &pipeline_layout));
+
+        cleanup_queue.push([logical_device, pipeline_layout]() { vkDestroyPipelineLayout(logical_device, pipeline_layout, nullptr); });
+
+        return pipeline_layout;
+    }
+
+    VkPipeline create_pipeline(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkPipelineCache pipeline_cache, shaders::module_cache& shaders_cache, cleanup::queue_type& cleanup_queue)
+    {
+        const auto create_info = VkComputePipelineCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shaders_cache.get_module(shader_path::compute::boids),
+                .pName = shader_entry_point.data(),
+                .pSpecializationInfo = nullptr
+            },
+            .layout = pipeline_layout,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = 0
+        };
+
+        auto pipeline = VkPipeline{};
+        VK_CHECK(vkCreateComputePipelines(logical_device, pipeline_cache, 1, &create_info, nullptr, &pipeline));
+
+        cleanup_queue.push([logical_device, pipeline]() { vkDestroyPipeline(logical_device, pipeline, nullptr); });
+
+        return pipeline;
+    }
+
+    std::vector<VkDescriptorSet> allocate_descriptor_sets(VkDevice logical_device, VkDescriptorPool pool, VkDescriptorSetLayout set_layout, std::size_t count)
+    {
+        const auto set_layouts = std::vector<VkDescriptorSetLayout>(count, set_layout);
+        const auto allocate_info = VkDescriptorSetAllocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = pool,
+            .descriptorSetCount = static_cast<uint32_t>(set_layouts.size()),
+            .pSetLayouts = set_layouts.data()
+        };
+
+        auto sets = std::vector<VkDescriptorSet>(count);
+        VK_CHECK(vkAllocateDescriptorSets(logical_device, &allocate_info, sets.data()));
+
+        return sets;
+    }
+
+    void update_descriptor_set(VkDevice logical_device, VkDescriptorSet set, VkBuffer previous_state, VkBuffer current_state, VkBuffer previous_velocities, VkBuffer current_velocities)
+    {
+        const auto buffer_infos = std::array{
+            VkDescriptorBufferInfo{ .buffer = previous_state, .offset = 0, .range = VK_WHOLE_SIZE },
+            VkDescriptorBufferInfo{ .buffer = current_state, .offset = 0, .range = VK_WHOLE_SIZE },
+            VkDescriptorBufferInfo{ .buffer = previous_velocities, .offset = 0, .range = VK_WHOLE_SIZE },
+            VkDescriptorBufferInfo{ .buffer = current_velocities, .offset = 0, .range = VK_WHOLE_SIZE },
+        };
+
+        const auto write = VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = nullptr,
+            .dstSet = set,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = buffer_infos.size(),
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pImageInfo = nullptr,
+            .pBufferInfo = buffer_infos.data(),
+            .pTexelBufferView = nullptr
+        };
+
+        vkUpdateDescriptorSets(logical_device, 1, &write, 0, nullptr);
+    }
+
+    void record_step(VkCommandBuffer command_buffer, VkPipeline pipeline, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set, const push_constants& params)
+    {
+        // the input was written by the previous step, the output may still be read by the previous frame's vertex shader
+        const auto before_step = VkMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &before_step, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(command_buffer, (params.count + workgroup_size - 1) / workgroup_size, 1, 1);
+
+        const auto after_step = VkMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &after_step, 0, nullptr, 0, nullptr);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "cleanup.hpp"
+#include "shader_module_cache.hpp"
+
+#include <Volk/volk.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace boids::compute
+{
+    // boids.comp tests every pair, 10^10 per step here. Larger flocks still run, only slower than the tick rate
+    constexpr auto max_recommended_count = uint32_t{ 100000 };
+
+    // matches Parameters block in boids.comp
+    struct push_constants
+    {
+        glm::vec4 min_range;
+        glm::vec4 max_range;
+        uint32_t count;
+        uint32_t spawned_first;
+        float visual_range;
+        float cohesion_weight;
+        float separation_weight;
+        float alignment_weight;
+        float wall_force_weight;
+        float speed;
+        float model_scale;
+    };
+
+    VkDescriptorSetLayout create_descriptor_set_layout(VkDevice logical_device, cleanup::queue_type& cleanup_queue);
+    VkPipelineLayout create_pipeline_layout(VkDevice logical_device, VkDescriptorSetLayout set_layout, cleanup::queue_type& cleanup_queue);
+    VkPipeline create_pipeline(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkPipelineCache pipeline_cache, shaders::module_cache& shaders_cache, cleanup::queue_type& cleanup_queue);
+
+    // One set per frame in flight. Flock state ping-pongs between two pairs of device local buffers, boids::instance and velocity,
+    // so the instance buffer written by a step is bound straight to triangle.vert.
+    std::vector<VkDescriptorSet> allocate_descriptor_sets(VkDevice logical_device, VkDescriptorPool pool, VkDescriptorSetLayout set_layout, std::size_t count);
+    // set must not be in use by a pending frame
+    void update_descriptor_set(VkDevice logical_device, VkDescriptorSet set, VkBuffer previous_state, VkBuffer current_state, VkBuffer previous_velocities, VkBuffer current_velocities);
+
+    // Records one simulation step, including barriers against previous steps and the vertex shader reading the result.
+    void record_step(VkCommandBuffer command_buffer, VkPipeline pipeline, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set, const push_constants& params);
+}
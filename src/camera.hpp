@@ -11,6 +11,8 @@ class camera final
 	float _yaw = -90.0f;
 	float _pitch = 0.0f;
 	float _fov = 45.0f;
+	float _z_near = 0.1f;
+	float _z_far = 200.f;
 
 	glm::vec3 _camera_pos = glm::vec3(0.0f, 1.0f, 3.0f);
 	glm::vec3 _camera_dir = glm::vec3(0.0f, 0.0f, -1.0f);
@@ -25,7 +27,10 @@ public:
 	auto& fov() { return _fov; }
 	auto& right() { return _camera_right; }
 
-	auto projection(float width, float height) { return glm::perspective(glm::radians(_fov), width / height, 0.1f, 200.f); }
+	auto z_near() const { return _z_near; }
+	auto z_far() const { return _z_far; }
+
+	auto projection(float width, float height) { return glm::perspective(glm::radians(_fov), width / height, _z_near, _z_far); }
 	auto view() {
 		return glm::lookAtLH(_camera_pos + _camera_dir, _camera_pos, _camera_up);
 	}
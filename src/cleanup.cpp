@@ -10,4 +10,27 @@ namespace cleanup
             queue.pop();
         }
     }
+
+    void deferred_queue::push(uint64_t frame, queue_type&& queue)
+    {
+        _pending.emplace_back(frame, std::move(queue));
+    }
+
+    void deferred_queue::collect(uint64_t frame)
+    {
+        while (!_pending.empty() && _pending.front().first + _frames_in_flight <= frame)
+        {
+            cleanup::flush(_pending.front().second);
+            _pending.pop_front();
+        }
+    }
+
+    void deferred_queue::flush()
+    {
+        for (auto& [_, queue] : _pending)
+        {
+            cleanup::flush(queue);
+        }
+        _pending.clear();
+    }
 }
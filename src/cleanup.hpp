@@ -1,11 +1,36 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
 #include <stack>
 #include <functional>
+#include <utility>
 
 namespace cleanup
 {
     using queue_type = std::stack<std::function<void()>>;
 
     void flush(queue_type& queue);
+
+    // For objects replaced while frames are in flight - their cleanup queue is only flushed once every frame that could still use them has finished.
+    class deferred_queue final
+    {
+    public:
+        explicit deferred_queue(uint64_t frames_in_flight) : _frames_in_flight(frames_in_flight) {}
+        ~deferred_queue() { flush(); }
+
+        deferred_queue(const deferred_queue&) = delete;
+        deferred_queue& operator=(const deferred_queue&) = delete;
+
+        // queue holds objects last used by frames before `frame`
+        void push(uint64_t frame, queue_type&& queue);
+        // call once `frame` waited for its fence
+        void collect(uint64_t frame);
+        // only after vkDeviceWaitIdle
+        void flush();
+
+    private:
+        uint64_t _frames_in_flight;
+        std::deque<std::pair<uint64_t, queue_type>> _pending;
+    };
 }
@@ -0,0 +1,87 @@
+#include "cli.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <system_error>
+
+namespace cli
+{
+    namespace
+    {
+        template<typename T>
+        std::optional<T> parse(std::string_view text)
+        {
+            auto value = T{};
+            const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (error != std::errc{} || end != text.data() + text.size())
+            {
+                return std::nullopt;
+            }
+            return value;
+        }
+
+        template<typename T>
+        T number_option(int argc, char** argv, std::string_view name, T default_value, std::optional<T> (*parse)(std::string_view))
+        {
+            const auto option = find_option(argc, argv, name);
+            if (!option)
+            {
+                return default_value;
+            }
+            if (const auto value = parse(*option))
+            {
+                return *value;
+            }
+            std::fprintf(stderr, "Ignoring %.*s %.*s, not a valid number.\n", static_cast<int>(name.size()), name.data(), static_cast<int>(option->size()), option->data());
+            return default_value;
+        }
+    }
+
+    std::optional<std::string_view> find_option(int argc, char** argv, std::string_view name)
+    {
+        for (int i = 1; i + 1 < argc; ++i)
+        {
+            if (argv[i] == name)
+            {
+                return argv[i + 1];
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    bool has_flag(int argc, char** argv, std::string_view name)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            if (argv[i] == name)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::optional<uint64_t> parse_uint(std::string_view text)
+    {
+        return parse<uint64_t>(text);
+    }
+
+    std::optional<float> parse_float(std::string_view text)
+    {
+        const auto value = parse<float>(text);
+        return value && std::isfinite(*value) ? value : std::nullopt;
+    }
+
+    uint64_t uint_option(int argc, char** argv, std::string_view name, uint64_t default_value)
+    {
+        return number_option(argc, argv, name, default_value, parse_uint);
+    }
+
+    float float_option(int argc, char** argv, std::string_view name, float default_value)
+    {
+        return number_option(argc, argv, name, default_value, parse_float);
+    }
+}
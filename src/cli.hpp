@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace cli
+{
+    // value following `name` on the command line, e.g. find_option(argc, argv, "--threads") for `--threads 4`
+    std::optional<std::string_view> find_option(int argc, char** argv, std::string_view name);
+    // option without a value, e.g. has_flag(argc, argv, "--validate")
+    bool has_flag(int argc, char** argv, std::string_view name);
+
+    // all of text as a number, nullopt if it isn't one or doesn't fit
+    std::optional<uint64_t> parse_uint(std::string_view text);
+    std::optional<float> parse_float(std::string_view text);
+
+    // find_option parsed as a number, default_value when it's missing. A value that doesn't parse is reported on stderr and gets default_value too
+    uint64_t uint_option(int argc, char** argv, std::string_view name, uint64_t default_value);
+    float float_option(int argc, char** argv, std::string_view name, float default_value);
+}
@@ -1,5 +1,8 @@
 #include "cone.hpp"
-#include "constants.hpp"
+#include "light.hpp"
+#include "light_clusters.hpp"
+#include "mesh.hpp"
+#include "pipeline_variants.hpp"
 #include "shaders/shaders.h"
 #include "vertex.hpp"
 #include "setup.hpp"
@@ -7,7 +10,10 @@
 #include <Volk/volk.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <map>
 #include <vector>
 #include <span>
 #include <numbers>
@@ -16,7 +22,7 @@ namespace cone
 {
     constexpr auto bindingDescription = VkVertexInputBindingDescription{
         .binding = 0,
-        .stride = 2 * sizeof(glm::vec3),
+        .stride = sizeof(packed_vertex),
         .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
     };
 
@@ -24,14 +30,14 @@ namespace cone
         VkVertexInputAttributeDescription{
             .location = 0,
             .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = 0
+            .format = VK_FORMAT_R16G16B16A16_SFLOAT,
+            .offset = offsetof(packed_vertex, pos)
         },
         VkVertexInputAttributeDescription{
             .location = 1,
             .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = sizeof glm::vec3
+            .format = VK_FORMAT_R16G16_SNORM,
+            .offset = offsetof(packed_vertex, normal)
         },
     };
 
@@ -53,31 +59,25 @@ namespace cone
         .primitiveRestartEnable = VK_FALSE
     };
 
-    auto viewport = VkViewport{
-        .x = 0.f,
-        .y = 0.f,
-        .width = 0.f,
-        .height = 0.f,
-        .minDepth = 0.f,
-        .maxDepth = 1.f
-    };
-
-    auto scissors = VkRect2D{
-        .offset = VkOffset2D{
-            .x = 0,
-            .y = 0,
-        },
-        .extent = {}
-    };
-
     const auto viewport_state = VkPipelineViewportStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
         .viewportCount = 1,
-        .pViewports = &viewport,
+        .pViewports = nullptr, // dynamic
         .scissorCount = 1,
-        .pScissors = &scissors,
+        .pScissors = nullptr, // dynamic
+    };
+
+    // set every frame, resizing doesn't touch the pipeline
+    constexpr auto dynamic_states = std::array{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    const auto dynamic_state = VkPipelineDynamicStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+        .pDynamicStates = dynamic_states.data()
     };
 
     constexpr auto rasterization_state = VkPipelineRasterizationStateCreateInfo{
@@ -96,18 +96,6 @@ namespace cone
         .lineWidth = 2.f
     };
 
-    constexpr auto multisample_state = VkPipelineMultisampleStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .rasterizationSamples = msaa_samples,
-        .sampleShadingEnable = VK_FALSE,
-        .minSampleShading = 1.f,
-        .pSampleMask = nullptr,
-        .alphaToCoverageEnable = VK_FALSE,
-        .alphaToOneEnable = VK_FALSE
-    };
-
     constexpr auto depth_stencil_state = VkPipelineDepthStencilStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
         .pNext = nullptr,
@@ -145,14 +133,13 @@ namespace cone
         .blendConstants = {0.f, 0.f, 0.f, 0.f}
     };
 
-    std::vector<vertex> generate_vertex_data()
+    std::vector<vertex> generate_vertex_data(std::size_t base_vertices_count)
     {
-        constexpr auto base_vertices_count = 12;
-        constexpr auto angle_step = 2 * std::numbers::pi / base_vertices_count;
-        constexpr auto base_triangles_count = base_vertices_count;
-        constexpr auto side_triangles_count = base_vertices_count;
-        constexpr auto triangles_count = base_triangles_count + side_triangles_count;
-        constexpr auto total_vertices_count = triangles_count * 3;
+        const auto angle_step = 2 * std::numbers::pi / base_vertices_count;
+        const auto base_triangles_count = base_vertices_count;
+        const auto side_triangles_count = base_vertices_count;
+        const auto triangles_count = base_triangles_count + side_triangles_count;
+        const auto total_vertices_count = triangles_count * 3;
 
         const auto center_vertex = glm::vec3(0, 0, 0);
         const auto top_vertex = glm::vec3(0, 2.f, 0);
@@ -197,9 +184,44 @@ namespace cone
         return vertices;
     }
 
-    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, const VkExtent2D& window_extent, shaders::module_cache& shaders_cache)
+    lod_meshes generate_lods(std::span<const uint32_t> base_vertices_counts)
     {
-        static const auto shader_stages = std::array{
+        auto meshes = lod_meshes{};
+        meshes.radius = 0.f;
+        for (const auto base_vertices_count : base_vertices_counts)
+        {
+            auto mesh = mesh::deduplicate(generate_vertex_data(base_vertices_count));
+            mesh::optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+            mesh::optimize_vertex_fetch(mesh);
+
+            meshes.lods.push_back(lod{
+                .first_index = static_cast<uint32_t>(meshes.indices.size()),
+                .index_count = static_cast<uint32_t>(mesh.indices.size()),
+                .vertex_offset = static_cast<int32_t>(meshes.vertices.size())
+            });
+            meshes.indices.insert(meshes.indices.end(), mesh.indices.begin(), mesh.indices.end());
+            for (const auto& vertex : mesh.vertices)
+            {
+                meshes.radius = std::max(meshes.radius, glm::length(vertex.pos));
+                meshes.vertices.push_back(mesh::quantize(vertex));
+            }
+        }
+        return meshes;
+    }
+
+    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkSampleCountFlagBits samples, shaders::module_cache& shaders_cache, uint32_t variant)
+    {
+        // one entry per variant, the create infos point into them
+        static auto specializations = std::map<uint32_t, pipelines::specialization<3>>{};
+        static auto variant_stages = std::map<uint32_t, std::array<VkPipelineShaderStageCreateInfo, 2>>{};
+
+        const auto& specialization = specializations.try_emplace(variant, std::array{
+            (variant & variant_directional_lights) ? static_cast<uint32_t>(light::max_directional_lights) : 0u,
+            (variant & variant_point_lights) ? static_cast<uint32_t>(clustering::max_lights_per_cluster) : 0u,
+            (variant & variant_specular) ? uint32_t{ VK_TRUE } : uint32_t{ VK_FALSE }
+        }).first->second;
+        auto& shader_stages = variant_stages[variant];
+        shader_stages = std::array{
             VkPipelineShaderStageCreateInfo{
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                 .pNext = nullptr,
@@ -216,15 +238,10 @@ namespace cone
                 .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
                 .module = shaders_cache.get_module(shader_path::fragment::triangle),
                 .pName = shader_entry_point.data(),
-                .pSpecializationInfo = nullptr
+                .pSpecializationInfo = &specialization.info
             }
         };
 
-        viewport.width = window_extent.width;
-        viewport.height = window_extent.height;
-
-        scissors.extent = window_extent;
-
         const auto create_info = VkGraphicsPipelineCreateInfo{
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
             .pNext = nullptr,
@@ -236,10 +253,10 @@ namespace cone
             .pTessellationState = nullptr,
             .pViewportState = &viewport_state,
             .pRasterizationState = &rasterization_state,
-            .pMultisampleState = &multisample_state,
+            .pMultisampleState = &get_multisample_state(samples),
             .pDepthStencilState = &depth_stencil_state,
             .pColorBlendState = &color_blend_state,
-            .pDynamicState = nullptr,
+            .pDynamicState = &dynamic_state,
             .layout = pipeline_layout,
             .renderPass = render_pass,
             .subpass = 0,
@@ -249,21 +266,4 @@ namespace cone
 
         return create_info;
     }
-
-    void generate_model_data(std::span<boids::boid>& cones, glm::vec3 min_range, glm::vec3 max_range)
-    {
-        auto rd = std::random_device{};
-        auto gen = std::mt19937(rd());
-        auto dis = std::uniform_real_distribution<>(-1., 1.);
-        auto x_dis = std::uniform_real_distribution<>(min_range.x, max_range.x);
-        auto y_dis = std::uniform_real_distribution<>(min_range.y, max_range.y);
-        auto z_dis = std::uniform_real_distribution<>(min_range.z, max_range.z);
-
-        for (auto& cone : cones)
-        {
-            cone.position = glm::vec4(x_dis(gen), y_dis(gen), z_dis(gen), 0.);
-            cone.direction = glm::normalize(glm::vec4(dis(gen), dis(gen), dis(gen), 0.));
-            cone.velocity = cone.direction;
-        }
-    }
 }
@@ -1,18 +1,46 @@
 #pragma once
 
-#include "boids.hpp" // huh?
 #include "vertex.hpp"
 #include "shader_module_cache.hpp"
 
 #include <Volk/volk.h>
-#include <array>
-#include <random>
 #include <span>
 #include <vector>
 
 namespace cone
 {
-    std::vector<vertex> generate_vertex_data();
-    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, const VkExtent2D& window_extent, shaders::module_cache& shaders_cache);
-    void generate_model_data(std::span<boids::boid>& cones, glm::vec3 min_range, glm::vec3 max_range);
+    // indices are relative to vertex_offset
+    struct lod
+    {
+        uint32_t first_index;
+        uint32_t index_count;
+        int32_t vertex_offset;
+    };
+
+    // every detail level in one vertex and one index array, most detailed first
+    struct lod_meshes
+    {
+        std::vector<packed_vertex> vertices;
+        std::vector<uint16_t> indices;
+        std::vector<lod> lods;
+        // bounding sphere around the origin, of the unquantized positions
+        float radius;
+    };
+
+    constexpr auto index_type = VK_INDEX_TYPE_UINT16;
+
+    // Features of the pipeline variants, specialization constants of triangle.frag. Every combination is a variant.
+    enum variant_bits : uint32_t
+    {
+        variant_directional_lights = 1 << 0,
+        variant_point_lights = 1 << 1,
+        variant_specular = 1 << 2,
+    };
+    constexpr auto variant_count = uint32_t{ 1 << 3 };
+    constexpr auto all_features = variant_count - 1;
+
+    std::vector<vertex> generate_vertex_data(std::size_t base_vertices_count = 12);
+    // One cone per base vertex count, deduplicated, in vertex cache friendly order and quantized.
+    lod_meshes generate_lods(std::span<const uint32_t> base_vertices_counts);
+    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkSampleCountFlagBits samples, shaders::module_cache& shaders_cache, uint32_t variant);
 }
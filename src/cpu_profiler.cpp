@@ -0,0 +1,223 @@
+#include "cpu_profiler.hpp"
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace profiling
+{
+    namespace
+    {
+        // a few frames of per chunk zones on every thread
+        constexpr auto ring_capacity = uint64_t{ 1 } << 16;
+
+        struct event
+        {
+            std::atomic<const char*> name;
+            std::atomic<uint64_t> begin_ns;
+            std::atomic<uint64_t> end_ns;
+        };
+
+        // Written by its thread only. Readers copy events out while it keeps writing and drop the ones that may have been overwritten meanwhile -
+        // started is bumped before a slot is touched, so anything within ring_capacity of it could be torn.
+        struct thread_ring
+        {
+            std::array<event, ring_capacity> events;
+            std::atomic<uint64_t> started = 0;
+            std::atomic<uint64_t> count = 0;
+            std::atomic<const char*> name = nullptr;
+            uint32_t id = 0;
+        };
+
+        struct registry
+        {
+            std::mutex mutex;
+            // shared, so a thread's zones outlive it until the trace is written
+            std::vector<std::shared_ptr<thread_ring>> rings;
+        };
+
+        registry& get_registry()
+        {
+            static auto registry = profiling::registry{};
+            return registry;
+        }
+
+        // allocated on first use, threads that never record a zone don't pay for a ring
+        thread_ring& local_ring()
+        {
+            thread_local const auto ring = []() {
+                auto ring = std::make_shared<thread_ring>();
+                auto& registry = get_registry();
+                const auto lock = std::scoped_lock(registry.mutex);
+                ring->id = static_cast<uint32_t>(registry.rings.size());
+                registry.rings.push_back(ring);
+                return ring;
+            }();
+            return *ring;
+        }
+
+        void write_string(std::ostream& out, std::string_view text)
+        {
+            out << '"';
+            for (const auto c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out << '\\';
+                }
+                out << c;
+            }
+            out << '"';
+        }
+    }
+
+    namespace detail
+    {
+        std::atomic<bool> zones_enabled = false;
+
+        uint64_t now_ns()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        void record(const char* name, uint64_t begin_ns, uint64_t end_ns)
+        {
+            auto& ring = local_ring();
+            const auto index = ring.count.load(std::memory_order_relaxed);
+            ring.started.store(index + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            auto& event = ring.events[index % ring_capacity];
+            event.name.store(name, std::memory_order_relaxed);
+            event.begin_ns.store(begin_ns, std::memory_order_relaxed);
+            event.end_ns.store(end_ns, std::memory_order_relaxed);
+            ring.count.store(index + 1, std::memory_order_release);
+        }
+    }
+
+    void set_enabled(bool enabled)
+    {
+        detail::zones_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    void set_thread_name(const char* name)
+    {
+        local_ring().name.store(name, std::memory_order_relaxed);
+    }
+
+    bool write_trace(const std::filesystem::path& path, uint64_t begin_ns, uint64_t end_ns)
+    {
+        struct copied_event
+        {
+            const char* name;
+            uint64_t begin_ns;
+            uint64_t end_ns;
+            uint32_t thread;
+        };
+
+        auto rings = std::vector<std::shared_ptr<thread_ring>>{};
+        {
+            auto& registry = get_registry();
+            const auto lock = std::scoped_lock(registry.mutex);
+            rings = registry.rings;
+        }
+
+        auto events = std::vector<copied_event>{};
+        for (const auto& ring : rings)
+        {
+            const auto count = ring->count.load(std::memory_order_acquire);
+            const auto first = count > ring_capacity ? count - ring_capacity : 0;
+            const auto copied_first = events.size();
+            for (auto i = first; i < count; ++i)
+            {
+                const auto& event = ring->events[i % ring_capacity];
+                events.push_back({ event.name.load(std::memory_order_relaxed), event.begin_ns.load(std::memory_order_relaxed), event.end_ns.load(std::memory_order_relaxed), ring->id });
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const auto started = ring->started.load(std::memory_order_relaxed);
+            for (auto i = first; i < count; ++i)
+            {
+                if (i + ring_capacity < started)
+                {
+                    events[copied_first + (i - first)].name = nullptr;
+                }
+            }
+        }
+
+        auto file = std::ofstream(path);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        // microseconds, relative to the start of the range so the viewer doesn't start at system boot
+        const auto to_us = [begin_ns](uint64_t ns) { return (static_cast<double>(ns) - static_cast<double>(begin_ns)) / 1000.; };
+
+        file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+        auto first_event = true;
+        const auto separator = [&]() -> std::ostream& {
+            if (!first_event)
+            {
+                file << ",\n";
+            }
+            first_event = false;
+            return file;
+        };
+
+        for (const auto& ring : rings)
+        {
+            if (const auto name = ring->name.load(std::memory_order_relaxed))
+            {
+                separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->id << ",\"args\":{\"name\":";
+                write_string(file, name);
+                file << "}}";
+            }
+        }
+
+        for (const auto& event : events)
+        {
+            if (event.name == nullptr || event.end_ns < begin_ns || event.end_ns >= end_ns)
+            {
+                continue;
+            }
+            separator() << "{\"name\":";
+            write_string(file, event.name);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << to_us(event.begin_ns) << ",\"dur\":" << (event.end_ns - event.begin_ns) / 1000. << "}";
+        }
+
+        file << "\n],\"displayTimeUnit\":\"ns\"}\n";
+        return static_cast<bool>(file.flush());
+    }
+
+    frame_capture::frame_capture(uint64_t first_frame, uint64_t last_frame, std::filesystem::path path)
+        : _first_frame(first_frame), _last_frame(last_frame), _path(std::move(path))
+    {
+    }
+
+    std::optional<bool> frame_capture::begin_frame(uint64_t frame)
+    {
+        if (_done)
+        {
+            return std::nullopt;
+        }
+
+        if (frame == _first_frame)
+        {
+            _begin_ns = now_ns();
+            set_enabled(true);
+        }
+        else if (frame == _last_frame + 1)
+        {
+            set_enabled(false);
+            _done = true;
+            return write_trace(_path, _begin_ns, now_ns());
+        }
+        return std::nullopt;
+    }
+}
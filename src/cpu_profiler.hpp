@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+namespace profiling
+{
+    namespace detail
+    {
+        extern std::atomic<bool> zones_enabled;
+
+        uint64_t now_ns();
+        void record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+    }
+
+    // Zones are only recorded while enabled, otherwise a zone costs one relaxed load.
+    inline bool enabled() { return detail::zones_enabled.load(std::memory_order_relaxed); }
+    void set_enabled(bool enabled);
+
+    // shows up as the thread's name in the trace, e.g. "render" or "simulation"
+    void set_thread_name(const char* name);
+
+    // Chrome trace_event json of every zone that ended in [begin_ns, end_ns), open it in chrome://tracing or ui.perfetto.dev.
+    // Each thread keeps only its latest zones, a long range loses its start on busy threads.
+    bool write_trace(const std::filesystem::path& path, uint64_t begin_ns, uint64_t end_ns);
+    inline uint64_t now_ns() { return detail::now_ns(); }
+
+    // name has to be a literal, or at least outlive the trace
+    class scoped_zone final
+    {
+    public:
+        explicit scoped_zone(const char* name) : _name(name), _begin_ns(enabled() ? detail::now_ns() : 0) {}
+        ~scoped_zone()
+        {
+            if (_begin_ns != 0 && enabled())
+            {
+                detail::record(_name, _begin_ns, detail::now_ns());
+            }
+        }
+
+        scoped_zone(const scoped_zone&) = delete;
+        scoped_zone(scoped_zone&&) = delete;
+        scoped_zone& operator=(const scoped_zone&) = delete;
+        scoped_zone& operator=(scoped_zone&&) = delete;
+
+    private:
+        const char* _name;
+        uint64_t _begin_ns;
+    };
+
+    // Records frames [first_frame, last_frame] and writes them to path once the last one ended.
+    class frame_capture final
+    {
+    public:
+        frame_capture(uint64_t first_frame, uint64_t last_frame, std::filesystem::path path);
+
+        // Call at the start of every frame. Set on the frame after the range, whether the trace could be written.
+        std::optional<bool> begin_frame(uint64_t frame);
+
+    private:
+        uint64_t _first_frame;
+        uint64_t _last_frame;
+        std::filesystem::path _path;
+        uint64_t _begin_ns = 0;
+        bool _done = false;
+    };
+}
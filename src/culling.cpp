@@ -0,0 +1,259 @@
+#include "culling.hpp"
+#include "setup.hpp"
+#include "vkcheck.hpp"
+
+#include <shaders/shaders.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace culling
+{
+    namespace
+    {
+        // local_size_x in cull.comp
+        constexpr auto workgroup_size = uint32_t{ 64 };
+        constexpr auto min_capacity = std::size_t{ 1024 };
+
+        VkDescriptorSetLayout create_descriptor_set_layout(VkDevice logical_device, cleanup::queue_type& cleanup_queue)
+        {
+            auto bindings = std::array<VkDescriptorSetLayoutBinding, 4>{};
+            for (uint32_t i = 0; i < bindings.size(); ++i)
+            {
+                bindings[i] = VkDescriptorSetLayoutBinding{
+                    .binding = i,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptorCount = 1,
+                    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .pImmutableSamplers = nullptr
+                };
+            }
+
+            const auto create_info = VkDescriptorSetLayoutCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .bindingCount = bindings.size(),
+                .pBindings = bindings.data()
+            };
+
+            auto layout = VkDescriptorSetLayout{};
+            VK_CHECK(vkCreateDescriptorSetLayout(logical_device, &create_info, nullptr, &layout));
+
+            cleanup_queue.push([logical_device, layout]() { vkDestroyDescriptorSetLayout(logical_device, layout, nullptr); });
+
+            return layout;
+        }
+
+        VkPipelineLayout create_pipeline_layout(VkDevice logical_device, VkDescriptorSetLayout set_layout, cleanup::queue_type& cleanup_queue)
+        {
+            const auto push_constant_range = VkPushConstantRange{
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(push_constants)
+            };
+
+            const auto create_info = VkPipelineLayoutCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .setLayoutCount = 1,
+                .pSetLayouts = &set_layout,
+                .pushConstantRangeCount = 1,
+                .pPushConstantRanges = &push_constant_range
+            };
+
+            auto pipeline_layout = VkPipelineLayout{};
+            VK_CHECK(vkCreatePipelineLayout(logical_device, &create_info, nullptr, &pipeline_layout));
+
+            cleanup_queue.push([logical_device, pipeline_layout]() { vkDestroyPipelineLayout(logical_device, pipeline_layout, nullptr); });
+
+            return pipeline_layout;
+        }
+
+        VkPipeline create_pipeline(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkPipelineCache pipeline_cache, shaders::module_cache& shaders_cache, cleanup::queue_type& cleanup_queue)
+        {
+            const auto create_info = VkComputePipelineCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .stage = VkPipelineShaderStageCreateInfo{
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = shaders_cache.get_module(shader_path::compute::cull),
+                    .pName = shader_entry_point.data(),
+                    .pSpecializationInfo = nullptr
+                },
+                .layout = pipeline_layout,
+                .basePipelineHandle = VK_NULL_HANDLE,
+                .basePipelineIndex = 0
+            };
+
+            auto pipeline = VkPipeline{};
+            VK_CHECK(vkCreateComputePipelines(logical_device, pipeline_cache, 1, &create_info, nullptr, &pipeline));
+
+            cleanup_queue.push([logical_device, pipeline]() { vkDestroyPipeline(logical_device, pipeline, nullptr); });
+
+            return pipeline;
+        }
+
+        void memory_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stages, VkAccessFlags src_access, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+        {
+            const auto barrier = VkMemoryBarrier{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = src_access,
+                .dstAccessMask = dst_access
+            };
+            vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+    }
+
+    std::array<glm::vec4, 6> frustum_planes(const glm::mat4& viewproj)
+    {
+        // Gribb & Hartmann, glm is column major so row i is m[*][i]
+        const auto row = [&viewproj](int i) { return glm::vec4(viewproj[0][i], viewproj[1][i], viewproj[2][i], viewproj[3][i]); };
+
+        auto planes = std::array{
+            row(3) + row(0),
+            row(3) - row(0),
+            row(3) + row(1),
+            row(3) - row(1),
+            // 0 <= z, GLM_FORCE_DEPTH_ZERO_TO_ONE
+            row(2),
+            row(3) - row(2)
+        };
+        for (auto& plane : planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return planes;
+    }
+
+    frustum_culler::frustum_culler(VkDevice logical_device, memory::device_allocator& allocator, VkPipelineCache pipeline_cache, shaders::module_cache& shaders_cache, VkDescriptorPool descriptor_pool, std::size_t frames_in_flight, std::span<const cone::lod> lods, cleanup::queue_type& cleanup_queue)
+        : _device(logical_device),
+        _allocator(allocator),
+        _lods(lods.begin(), lods.end()),
+        _set_layout(create_descriptor_set_layout(logical_device, cleanup_queue)),
+        _pipeline_layout(create_pipeline_layout(logical_device, _set_layout, cleanup_queue)),
+        _pipeline(create_pipeline(logical_device, _pipeline_layout, pipeline_cache, shaders_cache, cleanup_queue)),
+        _descriptor_sets(frames_in_flight),
+        _draw_buffers(frames_in_flight),
+        _visible_buffers(frames_in_flight)
+    {
+        assert(_lods.size() == lod_count);
+
+        const auto set_layouts = std::vector<VkDescriptorSetLayout>(frames_in_flight, _set_layout);
+        const auto allocate_info = VkDescriptorSetAllocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = static_cast<uint32_t>(set_layouts.size()),
+            .pSetLayouts = set_layouts.data()
+        };
+        VK_CHECK(vkAllocateDescriptorSets(_device, &allocate_info, _descriptor_sets.data()));
+
+        for (auto& draw_buffer : _draw_buffers)
+        {
+            draw_buffer = std::get<0>(create_buffer(_device, _allocator, lod_count * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cleanup_queue, memory::strategy::linear));
+        }
+    }
+
+    frustum_culler::~frustum_culler()
+    {
+        clear();
+    }
+
+    void frustum_culler::reserve(std::size_t count, uint64_t frame, cleanup::deferred_queue& retired)
+    {
+        if (count <= _capacity)
+        {
+            return;
+        }
+
+        const auto capacity = std::max({ count, 2 * _capacity, min_capacity });
+        auto cleanup_queue = cleanup::queue_type{};
+
+        auto visible_buffers = std::vector<VkBuffer>(_visible_buffers.size());
+        for (auto& visible_buffer : visible_buffers)
+        {
+            visible_buffer = std::get<0>(create_buffer(_device, _allocator, lod_count * capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cleanup_queue));
+        }
+
+        spdlog::info("Visible instance buffers grown from {} to {} boids.", _capacity, capacity);
+
+        retired.push(frame, std::move(_cleanup_queue));
+        _cleanup_queue = std::move(cleanup_queue);
+
+        _capacity = capacity;
+        _visible_buffers = std::move(visible_buffers);
+    }
+
+    void frustum_culler::record(VkCommandBuffer command_buffer, std::size_t frame_index, const VkDescriptorBufferInfo& model, const VkDescriptorBufferInfo& previous_model, const push_constants& params)
+    {
+        assert(params.count <= _capacity);
+
+        const auto descriptor_set = _descriptor_sets[frame_index];
+        const auto buffer_infos = std::array{
+            model,
+            previous_model,
+            visible_buffer_info(frame_index),
+            VkDescriptorBufferInfo{ .buffer = _draw_buffers[frame_index], .offset = 0, .range = VK_WHOLE_SIZE }
+        };
+        const auto write = VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = nullptr,
+            .dstSet = descriptor_set,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = buffer_infos.size(),
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pImageInfo = nullptr,
+            .pBufferInfo = buffer_infos.data(),
+            .pTexelBufferView = nullptr
+        };
+        vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+        auto draw_commands = std::array<VkDrawIndexedIndirectCommand, lod_count>{};
+        for (std::size_t i = 0; i < lod_count; ++i)
+        {
+            draw_commands[i] = VkDrawIndexedIndirectCommand{
+                .indexCount = _lods[i].index_count,
+                .instanceCount = 0,
+                .firstIndex = _lods[i].first_index,
+                .vertexOffset = _lods[i].vertex_offset,
+                .firstInstance = static_cast<uint32_t>(i * _capacity)
+            };
+        }
+        vkCmdUpdateBuffer(command_buffer, _draw_buffers[frame_index], 0, sizeof(draw_commands), draw_commands.data());
+
+        // instances come from simulation steps, uploads or staging copies
+        memory_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+        vkCmdPushConstants(command_buffer, _pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(command_buffer, (params.count + workgroup_size - 1) / workgroup_size, 1, 1);
+
+        memory_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+    }
+
+    VkDescriptorBufferInfo frustum_culler::visible_buffer_info(std::size_t frame_index) const
+    {
+        return VkDescriptorBufferInfo{
+            .buffer = _visible_buffers[frame_index],
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        };
+    }
+
+    void frustum_culler::clear()
+    {
+        cleanup::flush(_cleanup_queue);
+        _capacity = 0;
+        std::fill(_visible_buffers.begin(), _visible_buffers.end(), VK_NULL_HANDLE);
+    }
+}
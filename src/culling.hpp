@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cleanup.hpp"
+#include "cone.hpp"
+#include "device_allocator.hpp"
+#include "shader_module_cache.hpp"
+
+#include <Volk/volk.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <span>
+#include <vector>
+
+namespace culling
+{
+    // LOD_COUNT in cull.comp
+    constexpr auto lod_count = std::size_t{ 4 };
+
+    // matches Parameters block in cull.comp
+    struct push_constants
+    {
+        std::array<glm::vec4, 6> planes;
+        uint32_t count;
+        float interpolation;
+        float mesh_radius;
+        float projection_scale;
+        std::array<float, lod_count - 1> lod_thresholds;
+    };
+
+    // left, right, bottom, top, near, far of a [0, 1] depth projection, normalized and facing inwards
+    std::array<glm::vec4, 6> frustum_planes(const glm::mat4& viewproj);
+
+    // Compacts the boids inside the camera frustum into a per frame index buffer, bucketed by cone lod, and writes one VkDrawIndexedIndirectCommand per lod next to it.
+    // Each bucket has room for the whole flock. Index buffers grow with it like boids::instance_buffers, replaced ones are retired through the deferred queue.
+    class frustum_culler final
+    {
+    public:
+        // lods are ranges of the cone index buffer, lod_count of them
+        frustum_culler(VkDevice logical_device, memory::device_allocator& allocator, VkPipelineCache pipeline_cache, shaders::module_cache& shaders_cache, VkDescriptorPool descriptor_pool, std::size_t frames_in_flight, std::span<const cone::lod> lods, cleanup::queue_type& cleanup_queue);
+        ~frustum_culler();
+
+        frustum_culler(const frustum_culler&) = delete;
+        frustum_culler(frustum_culler&&) = delete;
+        frustum_culler& operator=(const frustum_culler&) = delete;
+        frustum_culler& operator=(frustum_culler&&) = delete;
+
+        void reserve(std::size_t count, uint64_t frame, cleanup::deferred_queue& retired);
+
+        // Records the culling dispatch outside a render pass, with barriers against whatever wrote the instances and the draw consuming the results.
+        // frame_index's draw and index buffers must not be in use by a pending frame.
+        void record(VkCommandBuffer command_buffer, std::size_t frame_index, const VkDescriptorBufferInfo& model, const VkDescriptorBufferInfo& previous_model, const push_constants& params);
+
+        // bound as VisibleInstances to triangle.vert
+        VkDescriptorBufferInfo visible_buffer_info(std::size_t frame_index) const;
+        // for vkCmdDrawIndexedIndirect, lod_count tightly packed commands
+        VkBuffer draw_buffer(std::size_t frame_index) const { return _draw_buffers[frame_index]; }
+
+        void clear();
+
+    private:
+        VkDevice _device;
+        memory::device_allocator& _allocator;
+        std::vector<cone::lod> _lods;
+        VkDescriptorSetLayout _set_layout;
+        VkPipelineLayout _pipeline_layout;
+        VkPipeline _pipeline;
+        std::vector<VkDescriptorSet> _descriptor_sets;
+        std::vector<VkBuffer> _draw_buffers;
+
+        std::size_t _capacity = 0;
+        std::vector<VkBuffer> _visible_buffers;
+        cleanup::queue_type _cleanup_queue;
+    };
+}
@@ -0,0 +1,247 @@
+#include "device_allocator.hpp"
+#include "setup.hpp"
+#include "vkcheck.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace memory
+{
+    namespace
+    {
+        constexpr auto default_block_size = VkDeviceSize{ 64 } << 20;
+
+        VkDeviceSize align_up(VkDeviceSize offset, VkDeviceSize alignment)
+        {
+            return (offset + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    device_allocator::device_allocator(VkDevice logical_device, VkPhysicalDevice physical_device)
+        : _device(logical_device), _physical_device(physical_device)
+    {
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &_memory_properties);
+    }
+
+    device_allocator::~device_allocator()
+    {
+        clear();
+    }
+
+    allocation device_allocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags memory_flags, bool image, strategy strategy)
+    {
+        const auto memory_type = find_memory_type_index(_physical_device, requirements.memoryTypeBits, memory_flags);
+        // small heaps, e.g. the 256MB host visible device local one, would be gone in a few blocks
+        const auto heap_size = _memory_properties.memoryHeaps[_memory_properties.memoryTypes[memory_type].heapIndex].size;
+        const auto block_size = std::min(default_block_size, heap_size / 8);
+
+        auto node = uint32_t{ 0 };
+        auto index = uint32_t{ 0 };
+        auto offset = std::optional<VkDeviceSize>{};
+        const auto lazily_allocated = (_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+        if (requirements.size > block_size / 2 || lazily_allocated)
+        {
+            index = create_block(requirements.size, memory_type, image, strategy, true);
+            offset = 0;
+        }
+        else
+        {
+            for (uint32_t i = 0; i < _blocks.size() && !offset; ++i)
+            {
+                auto& block = _blocks[i];
+                if (block.memory != VK_NULL_HANDLE && !block.dedicated && block.memory_type == memory_type && block.image == image && block.strategy == strategy)
+                {
+                    offset = suballocate(block, requirements, node);
+                    index = i;
+                }
+            }
+
+            if (!offset)
+            {
+                index = create_block(block_size, memory_type, image, strategy, false);
+                offset = suballocate(_blocks[index], requirements, node);
+                assert(offset);
+            }
+        }
+
+        auto& block = _blocks[index];
+        block.allocation_count++;
+
+        return allocation{
+            .memory = block.memory,
+            .offset = *offset,
+            .size = requirements.size,
+            .mapped = block.mapped ? reinterpret_cast<char*>(block.mapped) + *offset : nullptr,
+            .block = index,
+            .node = node
+        };
+    }
+
+    void device_allocator::free(const allocation& allocation)
+    {
+        auto& block = _blocks[allocation.block];
+        assert(block.memory == allocation.memory && block.allocation_count > 0);
+        block.allocation_count--;
+
+        if (block.dedicated)
+        {
+            // the slot is reused by the next block
+            vkFreeMemory(_device, block.memory, nullptr);
+            block.memory = VK_NULL_HANDLE;
+        }
+        else if (block.strategy == strategy::general)
+        {
+            block.ranges->free(allocation.node);
+        }
+        else if (block.allocation_count == 0)
+        {
+            block.top = 0;
+        }
+    }
+
+    bool device_allocator::supports(uint32_t memory_type_bits, VkMemoryPropertyFlags memory_flags) const
+    {
+        for (uint32_t i = 0; i < _memory_properties.memoryTypeCount; ++i)
+        {
+            if ((memory_type_bits & (1u << i)) && (_memory_properties.memoryTypes[i].propertyFlags & memory_flags) == memory_flags)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    VkDeviceSize device_allocator::committed_bytes(const allocation& allocation) const
+    {
+        const auto& block = _blocks[allocation.block];
+        if (!(_memory_properties.memoryTypes[block.memory_type].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+        {
+            return allocation.size;
+        }
+
+        auto committed = VkDeviceSize{ 0 };
+        vkGetDeviceMemoryCommitment(_device, block.memory, &committed);
+        return committed;
+    }
+
+    statistics device_allocator::stats() const
+    {
+        auto stats = statistics{};
+        auto free_bytes = VkDeviceSize{ 0 };
+        auto largest_free = VkDeviceSize{ 0 };
+        for (const auto& block : _blocks)
+        {
+            if (block.memory == VK_NULL_HANDLE)
+            {
+                continue;
+            }
+
+            stats.reserved_bytes += block.size;
+            stats.block_count++;
+            stats.allocation_count += block.allocation_count;
+
+            if (block.dedicated)
+            {
+                stats.used_bytes += block.size;
+            }
+            else if (block.strategy == strategy::general)
+            {
+                stats.used_bytes += block.ranges->used();
+                free_bytes += block.size - block.ranges->used();
+                largest_free = std::max(largest_free, block.ranges->largest_free());
+            }
+            else
+            {
+                // freed linear allocations below top stay lost until the block empties
+                stats.used_bytes += block.top;
+            }
+        }
+
+        stats.fragmentation = free_bytes > 0 ? 1.f - static_cast<float>(largest_free) / static_cast<float>(free_bytes) : 0.f;
+        return stats;
+    }
+
+    void device_allocator::clear()
+    {
+        for (const auto& block : _blocks)
+        {
+            if (block.memory != VK_NULL_HANDLE)
+            {
+                vkFreeMemory(_device, block.memory, nullptr);
+            }
+        }
+        _blocks.clear();
+    }
+
+    uint32_t device_allocator::create_block(VkDeviceSize size, uint32_t memory_type, bool image, strategy strategy, bool dedicated)
+    {
+        const auto allocate_info = VkMemoryAllocateInfo{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .allocationSize = size,
+            .memoryTypeIndex = memory_type
+        };
+
+        auto memory = VkDeviceMemory{};
+        VK_CHECK(vkAllocateMemory(_device, &allocate_info, nullptr, &memory));
+
+        void* mapped = nullptr;
+        if (_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            VK_CHECK(vkMapMemory(_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+        }
+
+        auto block = device_allocator::block{
+            .memory = memory,
+            .size = size,
+            .memory_type = memory_type,
+            .image = image,
+            .strategy = strategy,
+            .dedicated = dedicated,
+            .mapped = mapped,
+            .allocation_count = 0,
+            .ranges = strategy == strategy::general && !dedicated ? std::optional<tlsf>(std::in_place, size) : std::nullopt,
+            .top = 0
+        };
+
+        const auto free_slot = std::find_if(_blocks.begin(), _blocks.end(), [](const auto& block) { return block.memory == VK_NULL_HANDLE; });
+        const auto index = static_cast<uint32_t>(std::distance(_blocks.begin(), free_slot));
+        if (free_slot != _blocks.end())
+        {
+            *free_slot = std::move(block);
+        }
+        else
+        {
+            _blocks.push_back(std::move(block));
+        }
+
+        const auto stats = this->stats();
+        spdlog::info("Allocated {}{} MiB block of memory type {}, {} blocks / {} MiB reserved.", dedicated ? "dedicated " : "", size >> 20, memory_type, stats.block_count, stats.reserved_bytes >> 20);
+
+        return index;
+    }
+
+    std::optional<VkDeviceSize> device_allocator::suballocate(block& block, const VkMemoryRequirements& requirements, uint32_t& node)
+    {
+        if (block.strategy == strategy::general)
+        {
+            const auto range = block.ranges->allocate(requirements.size, requirements.alignment);
+            if (!range)
+            {
+                return std::nullopt;
+            }
+            node = range->node;
+            return range->offset;
+        }
+
+        const auto offset = align_up(block.top, requirements.alignment);
+        if (offset + requirements.size > block.size)
+        {
+            return std::nullopt;
+        }
+        block.top = offset + requirements.size;
+        return offset;
+    }
+}
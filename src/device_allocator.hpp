@@ -0,0 +1,92 @@
+#pragma once
+
+#include "tlsf.hpp"
+
+#include <Volk/volk.h>
+
+#include <optional>
+#include <vector>
+
+namespace memory
+{
+    enum class strategy
+    {
+        // freed one by one, e.g. instance buffers replaced as the flock grows or attachments recreated on resize
+        general,
+        // per frame rings and other buffers kept for the whole run. A block's space only comes back once everything in it was freed
+        linear
+    };
+
+    struct allocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        // whole blocks of host visible memory stay mapped
+        void* mapped = nullptr;
+        uint32_t block = 0;
+        uint32_t node = 0;
+    };
+
+    struct statistics
+    {
+        VkDeviceSize reserved_bytes = 0;
+        VkDeviceSize used_bytes = 0;
+        std::size_t block_count = 0;
+        std::size_t allocation_count = 0;
+        // 1 - largest free range / free bytes across general blocks, 0 while the free space is in one piece
+        float fragmentation = 0.f;
+    };
+
+    // Sub-allocates buffers and images from a few large VkDeviceMemory blocks instead of one vkAllocateMemory each.
+    // Blocks are per memory type, strategy and resource kind - buffers and optimal tiling images never share one, so bufferImageGranularity doesn't apply.
+    // Anything bigger than half a block gets a dedicated one, as does lazily allocated memory so its commitment can be queried per attachment.
+    class device_allocator final
+    {
+    public:
+        device_allocator(VkDevice logical_device, VkPhysicalDevice physical_device);
+        ~device_allocator();
+
+        device_allocator(const device_allocator&) = delete;
+        device_allocator(device_allocator&&) = delete;
+        device_allocator& operator=(const device_allocator&) = delete;
+        device_allocator& operator=(device_allocator&&) = delete;
+
+        allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags memory_flags, bool image, strategy strategy);
+        void free(const allocation& allocation);
+
+        // some memory type in memory_type_bits has all of memory_flags
+        bool supports(uint32_t memory_type_bits, VkMemoryPropertyFlags memory_flags) const;
+        // backed bytes of a lazily allocated allocation, its size otherwise
+        VkDeviceSize committed_bytes(const allocation& allocation) const;
+
+        statistics stats() const;
+        // frees every block, has to run before the device is destroyed
+        void clear();
+
+    private:
+        struct block
+        {
+            VkDeviceMemory memory;
+            VkDeviceSize size;
+            uint32_t memory_type;
+            bool image;
+            strategy strategy;
+            bool dedicated;
+            void* mapped;
+            std::size_t allocation_count;
+            // strategy::general only
+            std::optional<tlsf> ranges;
+            // strategy::linear only
+            VkDeviceSize top;
+        };
+
+        uint32_t create_block(VkDeviceSize size, uint32_t memory_type, bool image, strategy strategy, bool dedicated);
+        std::optional<VkDeviceSize> suballocate(block& block, const VkMemoryRequirements& requirements, uint32_t& node);
+
+        VkDevice _device;
+        VkPhysicalDevice _physical_device;
+        VkPhysicalDeviceMemoryProperties _memory_properties;
+        std::vector<block> _blocks;
+    };
+}
@@ -0,0 +1,86 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace resolution
+{
+    namespace
+    {
+        constexpr auto headroom = 0.85f;
+        // of the way to the target scale per sample
+        constexpr auto damping = 0.2f;
+        // finer steps only resize the render area back and forth without anyone noticing
+        constexpr auto min_step = 0.01f;
+    }
+
+    void controller::update(const settings& settings, float gpu_ms)
+    {
+        const auto min_scale = std::clamp(settings.min_scale, 0.1f, 1.f);
+        if (!settings.enabled)
+        {
+            _scale = 1.f;
+            return;
+        }
+        if (gpu_ms <= 0.f || (gpu_ms <= settings.budget_ms && gpu_ms >= headroom * settings.budget_ms))
+        {
+            _scale = std::clamp(_scale, min_scale, 1.f);
+            return;
+        }
+
+        // aim for the middle of the band, not its edge
+        const auto target_ms = 0.5f * (1.f + headroom) * settings.budget_ms;
+        const auto target = std::clamp(_scale * std::sqrt(target_ms / gpu_ms), min_scale, 1.f);
+        const auto step = damping * (target - _scale);
+        // the last bit of the way in one go
+        _scale = std::abs(step) >= min_step ? _scale + step : std::clamp(target, _scale - min_step, _scale + min_step);
+    }
+
+    VkExtent2D controller::extent(VkExtent2D full_extent) const
+    {
+        const auto scaled = [this](uint32_t size) {
+            return std::clamp(static_cast<uint32_t>(std::lround(size * _scale)), uint32_t{ 1 }, std::max(size, uint32_t{ 1 }));
+        };
+        return VkExtent2D{ scaled(full_extent.width), scaled(full_extent.height) };
+    }
+
+    void record_upscale(VkCommandBuffer command_buffer, VkImage render_target, VkExtent2D source_extent, VkImage swapchain_image, VkExtent2D swapchain_extent)
+    {
+        const auto color_range = VkImageSubresourceRange{
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        };
+
+        // the wait on image_available is at the transfer stage, chained through srcStageMask
+        const auto to_transfer_dst = VkImageMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = swapchain_image,
+            .subresourceRange = color_range
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_transfer_dst);
+
+        const auto layers = VkImageSubresourceLayers{
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        };
+        const auto blit = VkImageBlit{
+            .srcSubresource = layers,
+            .srcOffsets = { VkOffset3D{ 0, 0, 0 }, VkOffset3D{ static_cast<int32_t>(source_extent.width), static_cast<int32_t>(source_extent.height), 1 } },
+            .dstSubresource = layers,
+            .dstOffsets = { VkOffset3D{ 0, 0, 0 }, VkOffset3D{ static_cast<int32_t>(swapchain_extent.width), static_cast<int32_t>(swapchain_extent.height), 1 } }
+        };
+        vkCmdBlitImage(command_buffer, render_target, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+    }
+}
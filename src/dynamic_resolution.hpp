@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Volk/volk.h>
+
+namespace resolution
+{
+    // changed from the gui
+    struct settings
+    {
+        bool enabled = true;
+        // gpu milliseconds the scene may take, leaves room for the upscale and the gui below a 60 Hz frame
+        float budget_ms = 12.f;
+        // of the window's width and height
+        float min_scale = 0.5f;
+    };
+
+    // Scales the scene's render target between settings::min_scale and 1 of the window, so the measured gpu time settles just below the budget.
+    // Fragment cost goes with the area, so the scale moves towards sqrt(budget / time), damped - a sample is a couple of frames old and single slow frames shouldn't make it jump.
+    // Between headroom * budget and the budget it stays put, otherwise it would hunt around the budget forever.
+    class controller final
+    {
+    public:
+        // one call per new gpu time sample
+        void update(const settings& settings, float gpu_ms);
+
+        float scale() const { return _scale; }
+        // what the scene renders at, at least a pixel and never more than full_extent
+        VkExtent2D extent(VkExtent2D full_extent) const;
+
+    private:
+        float _scale = 1.f;
+    };
+
+    // Stretches source_extent of the render target, left in TRANSFER_SRC_OPTIMAL by the scene pass, over the whole swapchain image with linear filtering.
+    // The swapchain image's contents are discarded, it ends up in TRANSFER_DST_OPTIMAL for the gui pass.
+    void record_upscale(VkCommandBuffer command_buffer, VkImage render_target, VkExtent2D source_extent, VkImage swapchain_image, VkExtent2D swapchain_extent);
+}
@@ -0,0 +1,41 @@
+#include "fixed_timestep.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace timing
+{
+    fixed_timestep::fixed_timestep(double tick_rate, uint32_t max_ticks_per_advance) : _tick_seconds(1. / tick_rate), _max_ticks_per_advance(max_ticks_per_advance)
+    {
+        assert(tick_rate > 0. && max_ticks_per_advance > 0);
+    }
+
+    uint32_t fixed_timestep::advance(double elapsed)
+    {
+        _accumulator += std::max(elapsed, 0.);
+
+        const auto ticks = static_cast<uint32_t>(std::min(std::floor(_accumulator / _tick_seconds), static_cast<double>(_max_ticks_per_advance)));
+        _accumulator -= ticks * _tick_seconds;
+        if (_accumulator >= _tick_seconds)
+        {
+            _accumulator = std::fmod(_accumulator, _tick_seconds);
+        }
+
+        return ticks;
+    }
+
+    float fixed_timestep::interpolation() const
+    {
+        return static_cast<float>(_accumulator / _tick_seconds);
+    }
+
+    void fixed_timestep::set_tick_rate(double tick_rate)
+    {
+        assert(tick_rate > 0.);
+
+        const auto interpolation = _accumulator / _tick_seconds;
+        _tick_seconds = 1. / tick_rate;
+        _accumulator = interpolation * _tick_seconds;
+    }
+}
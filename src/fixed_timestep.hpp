@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+namespace timing
+{
+    // Hands out elapsed real time in fixed size ticks, so the simulation runs at the same rate whatever the frame rate is -
+    // several ticks in a slow frame, none in a fast one. What's left over is how far rendering is between the last two ticks.
+    class fixed_timestep final
+    {
+    public:
+        // At most max_ticks_per_advance ticks are handed out at once, time beyond that is dropped.
+        // Otherwise a tick slower than real time would ask for more ticks every frame and never catch up.
+        fixed_timestep(double tick_rate, uint32_t max_ticks_per_advance);
+
+        // adds elapsed seconds, returns how many ticks to run now
+        uint32_t advance(double elapsed);
+        // [0, 1), 0 draws the state before the last tick and 1 the state after it
+        float interpolation() const;
+        double seconds_until_next_tick() const { return _tick_seconds - _accumulator; }
+
+        double tick_rate() const { return 1. / _tick_seconds; }
+        // keeps the interpolation factor, so changing the rate doesn't make boids jump
+        void set_tick_rate(double tick_rate);
+
+    private:
+        double _tick_seconds;
+        uint32_t _max_ticks_per_advance;
+        double _accumulator = 0.;
+    };
+}
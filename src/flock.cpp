@@ -0,0 +1,196 @@
+#include "flock.hpp"
+#include "aquarium_bounds.hpp"
+#include "cpu_profiler.hpp"
+#include "steer_kernels.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <random>
+
+namespace boids
+{
+    namespace
+    {
+        // big enough to amortize claiming a chunk, small enough to balance dense and sparse regions
+        constexpr auto chunk_size = std::size_t{ 256 };
+
+        glm::vec3 steer(std::size_t slot, const sorted_flock& sorted, const spatial_hash& neighbours, const parameters& params, kernels::accumulate_function accumulate)
+        {
+            const auto px = sorted.x[slot];
+            const auto py = sorted.y[slot];
+            const auto pz = sorted.z[slot];
+
+            auto ranges = std::array<spatial_hash::range, spatial_hash::max_query_buckets>{};
+            const auto candidate_ranges = neighbours.candidate_ranges({ px, py, pz }, params.visual_range, ranges);
+            const auto candidates = kernels::candidates{ sorted.x.data(), sorted.y.data(), sorted.z.data(), sorted.vx.data(), sorted.vy.data(), sorted.vz.data() };
+            const auto [observed_boids, cx, cy, cz, sx, sy, sz, ax, ay, az] = accumulate(candidates, candidate_ranges.data(), candidate_ranges.size(), static_cast<uint32_t>(slot), px, py, pz, params.visual_range * params.visual_range);
+
+            if (observed_boids == 0)
+            {
+                return glm::vec3(0);
+            }
+
+            const auto inv_observed = 1.f / observed_boids;
+            const auto cohesion = (glm::vec3(cx, cy, cz) * inv_observed - glm::vec3(px, py, pz)) * params.cohesion_weight;
+            const auto separation = glm::vec3(sx, sy, sz) * params.separation_weight;
+            const auto alignment = glm::vec3(ax, ay, az) * inv_observed * params.alignment_weight;
+            return cohesion + separation + alignment;
+        }
+    }
+
+    void flock::resize(std::size_t count)
+    {
+        for (auto* v : { &x, &y, &z, &vx, &vy, &vz, &dx, &dy, &dz })
+        {
+            v->resize(count);
+        }
+        colors.resize(count, boid{}.color);
+    }
+
+    void spawn(flock& flock, glm::vec3 min_range, glm::vec3 max_range, std::size_t first, std::optional<uint32_t> seed)
+    {
+        auto rd = std::random_device{};
+        auto gen = std::mt19937(seed ? *seed : rd());
+        auto dis = std::uniform_real_distribution<>(-1., 1.);
+        auto x_dis = std::uniform_real_distribution<>(min_range.x, max_range.x);
+        auto y_dis = std::uniform_real_distribution<>(min_range.y, max_range.y);
+        auto z_dis = std::uniform_real_distribution<>(min_range.z, max_range.z);
+
+        for (auto i = first; i < flock.size(); ++i)
+        {
+            const auto direction = glm::normalize(glm::vec3(dis(gen), dis(gen), dis(gen)));
+            flock.x[i] = x_dis(gen);
+            flock.y[i] = y_dis(gen);
+            flock.z[i] = z_dis(gen);
+            flock.dx[i] = flock.vx[i] = direction.x;
+            flock.dy[i] = flock.vy[i] = direction.y;
+            flock.dz[i] = flock.vz[i] = direction.z;
+        }
+    }
+
+    void step(flock& flock, sorted_flock& sorted, spatial_hash& neighbours, const parameters& params, std::span<const plane_repellent> repellents, const glm::vec3& min_range, const glm::vec3& max_range, jobs::thread_pool& pool)
+    {
+        const auto zone = profiling::scoped_zone("boids::step");
+        const auto count = flock.size();
+
+        {
+            const auto zone = profiling::scoped_zone("rebuild spatial hash");
+            neighbours.rebuild(flock.x, flock.y, flock.z, params.visual_range);
+        }
+
+        const auto entries = neighbours.entries();
+        for (auto* v : { &sorted.x, &sorted.y, &sorted.z, &sorted.vx, &sorted.vy, &sorted.vz, &sorted.dx, &sorted.dy, &sorted.dz })
+        {
+            v->resize(count + kernels::padding);
+        }
+
+        pool.parallel_for(count, chunk_size, [&](std::size_t begin, std::size_t end) {
+            const auto zone = profiling::scoped_zone("sort chunk");
+            for (auto slot = begin; slot < end; ++slot)
+            {
+                const auto i = entries[slot];
+                sorted.x[slot] = flock.x[i];
+                sorted.y[slot] = flock.y[i];
+                sorted.z[slot] = flock.z[i];
+                sorted.vx[slot] = flock.vx[i];
+                sorted.vy[slot] = flock.vy[i];
+                sorted.vz[slot] = flock.vz[i];
+                sorted.dx[slot] = flock.dx[i];
+                sorted.dy[slot] = flock.dy[i];
+                sorted.dz[slot] = flock.dz[i];
+            }
+        });
+
+        // walking in bucket order keeps consecutive queries on the same cells
+        const auto accumulate = kernels::active();
+        pool.parallel_for(count, chunk_size, [&](std::size_t begin, std::size_t end) {
+            const auto zone = profiling::scoped_zone("steer chunk");
+            for (auto slot = begin; slot < end; ++slot)
+            {
+                const auto i = entries[slot];
+                const auto position = glm::vec3(sorted.x[slot], sorted.y[slot], sorted.z[slot]);
+
+                auto velocity_update = steer(slot, sorted, neighbours, params, accumulate);
+                for (const auto& repellent : repellents)
+                {
+                    velocity_update += repellent.get_velocity_diff(position);
+                }
+
+                auto direction = glm::vec3(sorted.dx[slot], sorted.dy[slot], sorted.dz[slot]);
+                const auto velocity = (direction + velocity_update) * params.speed;
+                if (glm::length(velocity))
+                    direction = glm::normalize(velocity);
+
+                const auto& [collision, normal] = aquarium::check_collision(glm::vec4(position + velocity, 0.), min_range, max_range);
+                if (collision)
+                {
+                    direction = glm::reflect(direction, normal);
+                }
+                else
+                {
+                    flock.x[i] = position.x + velocity.x;
+                    flock.y[i] = position.y + velocity.y;
+                    flock.z[i] = position.z + velocity.z;
+                }
+
+                flock.vx[i] = velocity.x;
+                flock.vy[i] = velocity.y;
+                flock.vz[i] = velocity.z;
+                flock.dx[i] = direction.x;
+                flock.dy[i] = direction.y;
+                flock.dz[i] = direction.z;
+            }
+        });
+    }
+
+    void pack(const flock& flock, float scale, std::span<instance> instances, std::size_t first)
+    {
+        assert(instances.size() >= flock.size());
+
+        for (auto i = first; i < flock.size(); ++i)
+        {
+            instances[i] = instance{
+                .position = glm::vec3(flock.x[i], flock.y[i], flock.z[i]),
+                .scale = scale,
+                .direction = glm::vec3(flock.dx[i], flock.dy[i], flock.dz[i]),
+                .color = glm::packUnorm4x8(flock.colors[i])
+            };
+        }
+    }
+
+    void capture(const flock& flock, poses& previous)
+    {
+        previous.x.assign(flock.x.begin(), flock.x.end());
+        previous.y.assign(flock.y.begin(), flock.y.end());
+        previous.z.assign(flock.z.begin(), flock.z.end());
+        previous.dx.assign(flock.dx.begin(), flock.dx.end());
+        previous.dy.assign(flock.dy.begin(), flock.dy.end());
+        previous.dz.assign(flock.dz.begin(), flock.dz.end());
+    }
+
+    void pack(const flock& flock, const poses& previous, float interpolation, float scale, std::span<instance> instances)
+    {
+        assert(instances.size() >= flock.size());
+
+        const auto interpolated_count = std::min(previous.size(), flock.size());
+        for (std::size_t i = 0; i < interpolated_count; ++i)
+        {
+            const auto direction = glm::vec3(flock.dx[i], flock.dy[i], flock.dz[i]);
+            const auto previous_direction = glm::vec3(previous.dx[i], previous.dy[i], previous.dz[i]);
+            // a reflection can turn a boid around completely, there is no direction half way
+            const auto interpolated_direction = glm::mix(previous_direction, direction, interpolation);
+
+            instances[i] = instance{
+                .position = glm::mix(glm::vec3(previous.x[i], previous.y[i], previous.z[i]), glm::vec3(flock.x[i], flock.y[i], flock.z[i]), interpolation),
+                .scale = scale,
+                .direction = glm::dot(interpolated_direction, interpolated_direction) > 0.f ? interpolated_direction : direction,
+                .color = glm::packUnorm4x8(flock.colors[i])
+            };
+        }
+
+        pack(flock, scale, instances, interpolated_count);
+    }
+}
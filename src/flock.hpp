@@ -0,0 +1,86 @@
+#pragma once
+
+#include "boids.hpp"
+#include "spatial_hash.hpp"
+#include "thread_pool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace boids
+{
+    // Structure of arrays flock. Neighbour search only touches positions and velocities, so each component gets its own contiguous array;
+    // direction is only read once per boid and colors are only read when packing for the gpu.
+    struct flock
+    {
+        flock() = default;
+        explicit flock(std::size_t count) { resize(count); }
+
+        std::size_t size() const { return x.size(); }
+        void resize(std::size_t count);
+
+        std::vector<float> x, y, z;
+        std::vector<float> vx, vy, vz;
+        std::vector<float> dx, dy, dz;
+        std::vector<glm::vec4> colors;
+    };
+
+    // Read buffer of step(): the previous tick copied in spatial_hash bucket order - boids from the same cell are adjacent in memory, so scanning a cell is a linear read.
+    // step() only reads this and only writes the flock, so the flock is updated in place without a copy of the whole state.
+    // Arrays only grow, keep one around between ticks and a tick of a constant size flock doesn't allocate.
+    // Arrays carry kernels::padding extra floats so the simd kernels can load past the last boid.
+    struct sorted_flock
+    {
+        std::vector<float> x, y, z;
+        std::vector<float> vx, vy, vz;
+        std::vector<float> dx, dy, dz;
+    };
+
+    // Positions and directions of a flock from one tick, what drawing needs to interpolate towards the next one
+    struct poses
+    {
+        std::size_t size() const { return x.size(); }
+
+        std::vector<float> x, y, z;
+        std::vector<float> dx, dy, dz;
+    };
+
+    // Per boid data read by triangle.vert, 32 bytes instead of the 112 of boid. The shader rebuilds the model matrix from position, direction and scale,
+    // and with a uniform scale the rotation alone transforms normals.
+    // Layout matches ConeInstance in triangle.vert and boids.comp.
+    struct instance
+    {
+        glm::vec3 position;
+        float scale;
+        glm::vec3 direction;
+        uint32_t color; // RGBA8, glm::packUnorm4x8
+    };
+    static_assert(sizeof(instance) == 32);
+
+    struct parameters
+    {
+        float visual_range;
+        float cohesion_weight;
+        float separation_weight;
+        float alignment_weight;
+        float speed;
+
+        bool operator==(const parameters&) const = default;
+    };
+
+    // random positions and directions for boids [first, size), the same ones every time for a given seed
+    void spawn(flock& flock, glm::vec3 min_range, glm::vec3 max_range, std::size_t first = 0, std::optional<uint32_t> seed = std::nullopt);
+    // Steering, wall repellents, collision and integration for the whole flock, split across the pool.
+    // Every boid only reads the sorted snapshot and writes its own slot, so the result doesn't depend on thread count.
+    void step(flock& flock, sorted_flock& sorted, spatial_hash& neighbours, const parameters& params, std::span<const plane_repellent> repellents, const glm::vec3& min_range, const glm::vec3& max_range, jobs::thread_pool& pool);
+    // copies the flock's poses into previous, before the last tick drawn next
+    void capture(const flock& flock, poses& previous);
+    // writes boids [first, size) into the same slots of instances
+    void pack(const flock& flock, float scale, std::span<instance> instances, std::size_t first = 0);
+    // Same as above for the whole flock, but interpolated from previous to the flock, interpolation in [0, 1]. Boids missing from previous are drawn where they are.
+    void pack(const flock& flock, const poses& previous, float interpolation, float scale, std::span<instance> instances);
+}
@@ -0,0 +1,131 @@
+#include "gpu_profiler.hpp"
+#include "vkcheck.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <numeric>
+
+namespace profiling
+{
+    namespace
+    {
+        // begin and end query per zone
+        constexpr auto max_zones = uint32_t{ 32 };
+    }
+
+    gpu_profiler::gpu_profiler(VkDevice logical_device, const VkPhysicalDeviceProperties& properties, uint32_t timestamp_valid_bits, std::size_t frames_in_flight, cleanup::queue_type& cleanup_queue)
+        : _device(logical_device),
+        _timestamp_period(properties.limits.timestampPeriod),
+        _timestamp_mask(timestamp_valid_bits >= 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << timestamp_valid_bits) - 1),
+        _recorded(frames_in_flight),
+        _results(2 * 2 * max_zones)
+    {
+        if (timestamp_valid_bits == 0)
+        {
+            spdlog::warn("Queue doesn't support timestamps, gpu profiler disabled.");
+            return;
+        }
+
+        const auto create_info = VkQueryPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2 * max_zones,
+            .pipelineStatistics = 0
+        };
+
+        _query_pools.resize(frames_in_flight);
+        for (auto& pool : _query_pools)
+        {
+            VK_CHECK(vkCreateQueryPool(_device, &create_info, nullptr, &pool));
+            cleanup_queue.push([logical_device, pool]() { vkDestroyQueryPool(logical_device, pool, nullptr); });
+        }
+    }
+
+    void gpu_profiler::begin_frame(VkCommandBuffer command_buffer, std::size_t frame_index)
+    {
+        if (!enabled())
+        {
+            return;
+        }
+
+        _frame_index = frame_index;
+        const auto pool = _query_pools[frame_index];
+        auto& recorded = _recorded[frame_index];
+
+        if (!recorded.empty())
+        {
+            // value and availability per query, no wait - the fence already says the commands are done
+            const auto query_count = static_cast<uint32_t>(2 * recorded.size());
+            const auto result = vkGetQueryPoolResults(_device, pool, 0, query_count, query_count * 2 * sizeof(uint64_t), _results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+            if (result != VK_SUCCESS && result != VK_NOT_READY)
+            {
+                VK_CHECK(result);
+            }
+
+            for (const auto& zone : recorded)
+            {
+                const auto begin = &_results[2 * zone.first_query];
+                const auto end = &_results[2 * (zone.first_query + 1)];
+                if (begin[1] != 0 && end[1] != 0)
+                {
+                    const auto ticks = ((end[0] & _timestamp_mask) - (begin[0] & _timestamp_mask)) & _timestamp_mask;
+                    add_sample(zone.name, static_cast<float>(ticks * static_cast<double>(_timestamp_period) / 1e6));
+                }
+            }
+            recorded.clear();
+        }
+
+        vkCmdResetQueryPool(command_buffer, pool, 0, 2 * max_zones);
+    }
+
+    uint32_t gpu_profiler::begin_zone(VkCommandBuffer command_buffer, std::string_view name)
+    {
+        auto& recorded = _recorded[_frame_index];
+        if (!enabled() || recorded.size() == max_zones)
+        {
+            return UINT32_MAX;
+        }
+
+        const auto first_query = static_cast<uint32_t>(2 * recorded.size());
+        recorded.push_back({ name, first_query });
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _query_pools[_frame_index], first_query);
+        return first_query;
+    }
+
+    void gpu_profiler::end_zone(VkCommandBuffer command_buffer, uint32_t zone)
+    {
+        if (zone == UINT32_MAX)
+        {
+            return;
+        }
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _query_pools[_frame_index], zone + 1);
+    }
+
+    const gpu_zone_stats* gpu_profiler::find(std::string_view name) const
+    {
+        const auto stats = std::find_if(_stats.begin(), _stats.end(), [name](const auto& stats) { return stats.name == name; });
+        return stats != _stats.end() ? &*stats : nullptr;
+    }
+
+    void gpu_profiler::add_sample(std::string_view name, float milliseconds)
+    {
+        auto stats = std::find_if(_stats.begin(), _stats.end(), [name](const auto& stats) { return stats.name == name; });
+        if (stats == _stats.end())
+        {
+            _stats.push_back(gpu_zone_stats{ .name = name });
+            stats = std::prev(_stats.end());
+        }
+
+        stats->history[stats->history_offset] = milliseconds;
+        stats->history_offset = (stats->history_offset + 1) % stats->history.size();
+        stats->samples++;
+
+        // until the ring is full only its front holds samples
+        const auto filled = std::min(stats->samples, stats->history.size());
+        stats->average = std::accumulate(stats->history.begin(), stats->history.begin() + filled, 0.f) / filled;
+        stats->peak = *std::max_element(stats->history.begin(), stats->history.begin() + filled);
+    }
+}
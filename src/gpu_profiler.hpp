@@ -0,0 +1,89 @@
+#pragma once
+
+#include "cleanup.hpp"
+
+#include <Volk/volk.h>
+
+#include <array>
+#include <string_view>
+#include <vector>
+
+namespace profiling
+{
+    struct gpu_zone_stats
+    {
+        std::string_view name;
+        // milliseconds, a ring - history_offset is the oldest sample
+        std::array<float, 128> history{};
+        std::size_t history_offset = 0;
+        std::size_t samples = 0;
+        float average = 0.f;
+        float peak = 0.f;
+
+        float latest() const { return history[(history_offset + history.size() - 1) % history.size()]; }
+    };
+
+    // Timestamps around groups of commands, one query pool per frame in flight.
+    // A frame slot's results are read once its fence was waited for, so they're frames_in_flight frames old and reading never stalls.
+    // Does nothing on queues without timestamp support.
+    class gpu_profiler final
+    {
+    public:
+        gpu_profiler(VkDevice logical_device, const VkPhysicalDeviceProperties& properties, uint32_t timestamp_valid_bits, std::size_t frames_in_flight, cleanup::queue_type& cleanup_queue);
+
+        gpu_profiler(const gpu_profiler&) = delete;
+        gpu_profiler(gpu_profiler&&) = delete;
+        gpu_profiler& operator=(const gpu_profiler&) = delete;
+        gpu_profiler& operator=(gpu_profiler&&) = delete;
+
+        // Collects what frame_index recorded last time and resets its queries. Call outside a render pass, right after the command buffer begins.
+        void begin_frame(VkCommandBuffer command_buffer, std::size_t frame_index);
+
+        // name has to outlive the profiler, zones are told apart by it
+        uint32_t begin_zone(VkCommandBuffer command_buffer, std::string_view name);
+        void end_zone(VkCommandBuffer command_buffer, uint32_t zone);
+
+        bool enabled() const { return _query_pools.size() > 0; }
+        const std::vector<gpu_zone_stats>& zones() const { return _stats; }
+        // nullptr until the zone has a sample
+        const gpu_zone_stats* find(std::string_view name) const;
+
+    private:
+        struct recorded_zone
+        {
+            std::string_view name;
+            uint32_t first_query;
+        };
+
+        void add_sample(std::string_view name, float milliseconds);
+
+        VkDevice _device;
+        float _timestamp_period;
+        uint64_t _timestamp_mask;
+        std::vector<VkQueryPool> _query_pools;
+        std::vector<std::vector<recorded_zone>> _recorded;
+        std::size_t _frame_index = 0;
+        std::vector<uint64_t> _results;
+        std::vector<gpu_zone_stats> _stats;
+    };
+
+    class scoped_gpu_zone final
+    {
+    public:
+        scoped_gpu_zone(gpu_profiler& profiler, VkCommandBuffer command_buffer, std::string_view name)
+            : _profiler(profiler), _command_buffer(command_buffer), _zone(profiler.begin_zone(command_buffer, name))
+        {
+        }
+        ~scoped_gpu_zone() { _profiler.end_zone(_command_buffer, _zone); }
+
+        scoped_gpu_zone(const scoped_gpu_zone&) = delete;
+        scoped_gpu_zone(scoped_gpu_zone&&) = delete;
+        scoped_gpu_zone& operator=(const scoped_gpu_zone&) = delete;
+        scoped_gpu_zone& operator=(scoped_gpu_zone&&) = delete;
+
+    private:
+        gpu_profiler& _profiler;
+        VkCommandBuffer _command_buffer;
+        uint32_t _zone;
+    };
+}
@@ -1,11 +1,12 @@
 #include "grid.hpp"
-#include "constants.hpp"
 #include "shaders/shaders.h"
 #include "cleanup.hpp"
 #include "setup.hpp"
+#include "pipeline_variants.hpp"
 
 #include <cassert>
 #include <array>
+#include <map>
 
 namespace grid
 {
@@ -28,31 +29,25 @@ namespace grid
         .primitiveRestartEnable = VK_FALSE
     };
 
-    auto viewport = VkViewport{
-        .x = 0.f,
-        .y = 0.f,
-        .width = 0.f,
-        .height = 0.f,
-        .minDepth = 0.f,
-        .maxDepth = 1.f
-    };
-
-    auto scissors = VkRect2D{
-        .offset = VkOffset2D{
-            .x = 0,
-            .y = 0,
-        },
-        .extent = {}
-    };
-
     const auto viewport_state = VkPipelineViewportStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
         .viewportCount = 1,
-        .pViewports = &viewport,
+        .pViewports = nullptr, // dynamic
         .scissorCount = 1,
-        .pScissors = &scissors,
+        .pScissors = nullptr, // dynamic
+    };
+
+    // set every frame, resizing doesn't touch the pipeline
+    constexpr auto dynamic_states = std::array{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    const auto dynamic_state = VkPipelineDynamicStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+        .pDynamicStates = dynamic_states.data()
     };
 
     constexpr auto rasterization_state = VkPipelineRasterizationStateCreateInfo{
@@ -71,18 +66,6 @@ namespace grid
         .lineWidth = 2.f
     };
 
-    constexpr auto multisample_state = VkPipelineMultisampleStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .rasterizationSamples = msaa_samples,
-        .sampleShadingEnable = VK_FALSE,
-        .minSampleShading = 1.f,
-        .pSampleMask = nullptr,
-        .alphaToCoverageEnable = VK_FALSE,
-        .alphaToOneEnable = VK_FALSE
-    };
-
     constexpr auto depth_stencil_state = VkPipelineDepthStencilStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
         .pNext = nullptr,
@@ -120,9 +103,18 @@ namespace grid
         .blendConstants = {0.f, 0.f, 0.f, 0.f}
     };
 
-    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, const VkExtent2D& window_extent, shaders::module_cache& shaders_cache)
+    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkSampleCountFlagBits samples, shaders::module_cache& shaders_cache, uint32_t variant)
     {
-        static const auto shader_stages = std::array{
+        // one entry per variant, the create infos point into them
+        static auto specializations = std::map<uint32_t, pipelines::specialization<2>>{};
+        static auto variant_stages = std::map<uint32_t, std::array<VkPipelineShaderStageCreateInfo, 2>>{};
+
+        const auto& specialization = specializations.try_emplace(variant, std::array{
+            (variant & variant_axis) ? uint32_t{ VK_TRUE } : uint32_t{ VK_FALSE },
+            (variant & variant_arrows) ? uint32_t{ VK_TRUE } : uint32_t{ VK_FALSE }
+        }).first->second;
+        auto& shader_stages = variant_stages[variant];
+        shader_stages = std::array{
             VkPipelineShaderStageCreateInfo{
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                 .pNext = nullptr,
@@ -139,15 +131,10 @@ namespace grid
                 .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
                 .module = shaders_cache.get_module(shader_path::fragment::grid),
                 .pName = shader_entry_point.data(),
-                .pSpecializationInfo = nullptr
+                .pSpecializationInfo = &specialization.info
             }
         };
 
-        viewport.width = window_extent.width;
-        viewport.height = window_extent.height;
-
-        scissors.extent = window_extent;
-
         const auto create_info = VkGraphicsPipelineCreateInfo{
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
             .pNext = nullptr,
@@ -159,10 +146,10 @@ namespace grid
             .pTessellationState = nullptr,
             .pViewportState = &viewport_state,
             .pRasterizationState = &rasterization_state,
-            .pMultisampleState = &multisample_state,
+            .pMultisampleState = &get_multisample_state(samples),
             .pDepthStencilState = &depth_stencil_state,
             .pColorBlendState = &color_blend_state,
-            .pDynamicState = nullptr,
+            .pDynamicState = &dynamic_state,
             .layout = pipeline_layout,
             .renderPass = render_pass,
             .subpass = 0,
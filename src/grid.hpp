@@ -4,9 +4,34 @@
 
 #include <Volk/volk.h>
 
+#include <array>
+#include <cstdint>
 #include <vector>
 
 namespace grid
 {
-    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, const VkExtent2D& window_extent, shaders::module_cache& shaders_cache);
+    // Features of the pipeline variants, specialization constants of grid.frag
+    enum variant_bits : uint32_t
+    {
+        variant_axis = 1 << 0,
+        // only with the axis
+        variant_arrows = 1 << 1,
+    };
+    constexpr auto all_features = uint32_t{ variant_axis | variant_arrows };
+
+    // Arrows without the axis draw the same as no features, so only these combinations get a pipeline
+    constexpr auto variants = std::array{ uint32_t{ 0 }, uint32_t{ variant_axis }, all_features };
+    constexpr auto variant_count = static_cast<uint32_t>(variants.size());
+
+    // index into variants of the pipeline drawing `features`
+    constexpr uint32_t variant_index(uint32_t features)
+    {
+        if (!(features & variant_axis))
+        {
+            return 0;
+        }
+        return (features & variant_arrows) ? 2 : 1;
+    }
+
+    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkSampleCountFlagBits samples, shaders::module_cache& shaders_cache, uint32_t variant);
 }
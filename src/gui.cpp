@@ -1,6 +1,9 @@
 #include "gui.hpp"
-#include "constants.hpp"
-#include "boids.hpp"
+#include "aquarium_bounds.hpp"
+#include "cone.hpp"
+#include "cpu_profiler.hpp"
+#include "flock.hpp"
+#include "grid.hpp"
 #include "vkcheck.hpp"
 
 #include <imgui.h>
@@ -10,7 +13,9 @@
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/compile.h>
 
+#include <algorithm>
 #include <span>
+#include <string>
 
 namespace gui
 {
@@ -72,7 +77,7 @@ namespace gui
         init_info.Subpass = 0;
         init_info.MinImageCount = images_count,
         init_info.ImageCount = images_count,
-        init_info.MSAASamples = msaa_samples;
+        init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
         init_info.Allocator = nullptr;
         init_info.CheckVkResultFn = [](VkResult r) { VK_CHECK(r); };
         ImGui_ImplVulkan_Init(&init_info, render_pass);
@@ -111,6 +116,7 @@ namespace gui
 
     void draw(VkCommandBuffer command_buffer, data_refs& data)
     {
+        const auto zone = profiling::scoped_zone("gui::draw");
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -123,9 +129,23 @@ namespace gui
             alignment_weight,
             visual_range,
             wall_force_weight,
+            tick_rate,
+            instances_count,
+            max_instances_count,
+            recommended_instances_count,
+            lod_thresholds,
+            cone_variant,
+            grid_variant,
+            msaa_samples,
+            supported_sample_counts,
+            resolution,
+            render_extent,
             cones,
+            set_color,
             dir_lights,
-            point_lights
+            point_lights,
+            device_memory,
+            gpu_profiler
         ] = data;
 
         ImGui::Text("Camera");
@@ -154,9 +174,93 @@ namespace gui
         ImGui::DragFloat("Visual range", &visual_range, 0.1f, 0.f, 30.f);
         ImGui::Separator();
         ImGui::DragFloat("Wall force", &wall_force_weight, 0.01f, 0.f, 1.f);
+        ImGui::Separator();
+        ImGui::DragFloat("Tick rate", &tick_rate, 1.f, 1.f, 1000.f, "%.0f Hz");
+        tick_rate = std::max(tick_rate, 1.f);
+        ImGui::Separator();
+        constexpr auto instances_step = uint32_t{ 100 };
+        constexpr auto instances_step_fast = uint32_t{ 10000 };
+        ImGui::InputScalar("Boids", ImGuiDataType_U32, &instances_count, &instances_step, &instances_step_fast);
+        for (const auto amount : { 1000, 10000, 100000 })
+        {
+            if (ImGui::Button(fmt::format("+{}", amount).c_str()))
+            {
+                instances_count += amount;
+            }
+            ImGui::SameLine();
+        }
+        if (ImGui::Button("Despawn half"))
+        {
+            instances_count /= 2;
+        }
+        instances_count = std::min(instances_count, max_instances_count);
+        if (recommended_instances_count != 0 && instances_count > recommended_instances_count)
+        {
+            ImGui::TextColored(ImVec4(1.f, 0.6f, 0.f, 1.f), "Over %u boids the gpu simulation can't keep up", recommended_instances_count);
+        }
+        ImGui::Separator();
+        ImGui::DragScalarN("Lod thresholds", ImGuiDataType_Float, lod_thresholds.data(), static_cast<int>(lod_thresholds.size()), 0.1f, nullptr, nullptr, "%.1f px");
+        // each level has to start below the previous one
+        for (std::size_t i = 0; i < lod_thresholds.size(); ++i)
+        {
+            lod_thresholds[i] = std::max(lod_thresholds[i], 0.f);
+            if (i > 0)
+            {
+                lod_thresholds[i] = std::min(lod_thresholds[i], lod_thresholds[i - 1]);
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Shader variants"))
+        {
+            // prebuilt pipelines, nothing compiles when these change
+            ImGui::CheckboxFlags("Directional lights", &cone_variant, cone::variant_directional_lights);
+            ImGui::CheckboxFlags("Point lights", &cone_variant, cone::variant_point_lights);
+            ImGui::CheckboxFlags("Specular", &cone_variant, cone::variant_specular);
+            ImGui::Separator();
+            ImGui::CheckboxFlags("Grid axis", &grid_variant, grid::variant_axis);
+            ImGui::CheckboxFlags("Grid arrows", &grid_variant, grid::variant_arrows);
+        }
+
+        if (ImGui::CollapsingHeader("Rendering"))
+        {
+            // the render pass, attachments and scene pipelines are rebuilt next frame
+            if (ImGui::BeginCombo("MSAA", fmt::format("{}x", static_cast<int>(msaa_samples)).c_str()))
+            {
+                for (const auto samples : supported_sample_counts)
+                {
+                    if (ImGui::Selectable(fmt::format("{}x", static_cast<int>(samples)).c_str(), samples == msaa_samples))
+                    {
+                        msaa_samples = samples;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+
+            ImGui::Checkbox("Dynamic resolution", &resolution.enabled);
+            ImGui::DragFloat("GPU budget (ms)", &resolution.budget_ms, 0.1f, 1.f, 100.f);
+            ImGui::SliderFloat("Min scale", &resolution.min_scale, 0.25f, 1.f);
+            ImGui::Text(fmt::format("Scene at {}x{}", render_extent.width, render_extent.height).c_str());
+        }
 
         if (ImGui::CollapsingHeader(fmt::format("lights [{}]", dir_lights.size() + point_lights.size()).c_str()))
         {
+            // stress test for the light clusters
+            static auto spawn_count = 100;
+            ImGui::InputInt("##point lights to spawn", &spawn_count, 10, 100);
+            spawn_count = std::clamp(spawn_count, 0, static_cast<int>(light::max_point_lights));
+            ImGui::SameLine();
+            if (ImGui::Button("Spawn point lights"))
+            {
+                light::spawn_point_lights(point_lights, spawn_count, aquarium::min_range, aquarium::max_range);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear"))
+            {
+                point_lights.clear();
+            }
+            ImGui::Text(fmt::format("{} / {} point lights", point_lights.size(), light::max_point_lights).c_str());
+            ImGui::Separator();
+
             for (std::size_t i = 0; i < dir_lights.size(); ++i)
             {
                 if (ImGui::TreeNode(fmt::format("Dir light {}", i).c_str()))
@@ -188,25 +292,85 @@ namespace gui
             }
         }
 
-        if (ImGui::CollapsingHeader(fmt::format("Instances [{}]", cones.size()).c_str()))
+        if (ImGui::CollapsingHeader(fmt::format("Instances [{}]", cones->size()).c_str()))
         {
-            for (std::size_t i = 0; i < cones.size(); ++i)
+            // only the visible rows, the flock can be a million boids
+            auto clipper = ImGuiListClipper();
+            clipper.Begin(static_cast<int>(cones->size()));
+            while (clipper.Step())
             {
-                if (ImGui::TreeNode(fmt::format("Instance {}", i).c_str()))
+                for (std::size_t i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
                 {
-                    auto& cone = cones[i];
-                    const auto pos_str = fmt::format(vec3_format, cone.position.x, cone.position.y, cone.position.z);
-                    const auto dir_str = fmt::format(vec3_format, cone.direction.x, cone.direction.y, cone.direction.z);
-                    const auto color_str = fmt::format(vec4_format, cone.color.x, cone.color.y, cone.color.z, cone.color.w);
-                    const auto velocity_str = fmt::format(vec3_format, cone.velocity.x, cone.velocity.y, cone.velocity.z);
-                    ImGui::Text(fmt::format(aligned_vectors_format, "pos:", pos_str).c_str());
-                    ImGui::Text(fmt::format(aligned_vectors_format, "dir:", dir_str).c_str());
-                    ImGui::Text(fmt::format(aligned_vectors_format, "velocity:", velocity_str).c_str());
-                    ImGui::Text(fmt::format(aligned_vectors_format, "color:", color_str).c_str());
-                    ImGui::SameLine();
-                    ImGui::ColorEdit4("", &cone.color[0], ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_PickerHueWheel);
-                    ImGui::TreePop();
+                    if (ImGui::TreeNode(fmt::format("Instance {}", i).c_str()))
+                    {
+                        const auto& flock = *cones;
+                        auto color = flock.colors[i];
+                        const auto pos_str = fmt::format(vec3_format, flock.x[i], flock.y[i], flock.z[i]);
+                        const auto dir_str = fmt::format(vec3_format, flock.dx[i], flock.dy[i], flock.dz[i]);
+                        const auto color_str = fmt::format(vec4_format, color.x, color.y, color.z, color.w);
+                        const auto velocity_str = fmt::format(vec3_format, flock.vx[i], flock.vy[i], flock.vz[i]);
+                        ImGui::Text(fmt::format(aligned_vectors_format, "pos:", pos_str).c_str());
+                        ImGui::Text(fmt::format(aligned_vectors_format, "dir:", dir_str).c_str());
+                        ImGui::Text(fmt::format(aligned_vectors_format, "velocity:", velocity_str).c_str());
+                        ImGui::Text(fmt::format(aligned_vectors_format, "color:", color_str).c_str());
+                        ImGui::SameLine();
+                        if (ImGui::ColorEdit4("", &color[0], ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_PickerHueWheel))
+                        {
+                            set_color(i, color);
+                        }
+                        ImGui::TreePop();
+                    }
+                }
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Device memory"))
+        {
+            const auto stats = device_memory.stats();
+            ImGui::Text(fmt::format("reserved: {:.1f} MiB in {} blocks", stats.reserved_bytes / double(1 << 20), stats.block_count).c_str());
+            ImGui::Text(fmt::format("used: {:.1f} MiB by {} allocations", stats.used_bytes / double(1 << 20), stats.allocation_count).c_str());
+            ImGui::Text(fmt::format("fragmentation: {:.0f}%", 100.f * stats.fragmentation).c_str());
+        }
+
+        if (ImGui::CollapsingHeader("GPU timings") && gpu_profiler.enabled())
+        {
+            const auto& zones = gpu_profiler.zones();
+            if (ImGui::BeginTable("gpu zones", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+            {
+                ImGui::TableSetupColumn("zone");
+                ImGui::TableSetupColumn("avg ms");
+                ImGui::TableSetupColumn("peak ms");
+                ImGui::TableHeadersRow();
+                for (const auto& zone : zones)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(zone.name.data(), zone.name.data() + zone.name.size());
+                    ImGui::TableNextColumn();
+                    ImGui::Text(fmt::format("{:.3f}", zone.average).c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::Text(fmt::format("{:.3f}", zone.peak).c_str());
+                }
+                ImGui::EndTable();
+            }
+
+            static auto plotted_zone = 0;
+            if (!zones.empty())
+            {
+                plotted_zone = std::min(plotted_zone, static_cast<int>(zones.size()) - 1);
+                const auto& zone = zones[plotted_zone];
+                if (ImGui::BeginCombo("Graph", std::string(zone.name).c_str()))
+                {
+                    for (std::size_t i = 0; i < zones.size(); ++i)
+                    {
+                        if (ImGui::Selectable(std::string(zones[i].name).c_str(), static_cast<int>(i) == plotted_zone))
+                        {
+                            plotted_zone = static_cast<int>(i);
+                        }
+                    }
+                    ImGui::EndCombo();
                 }
+                ImGui::PlotLines("##gpu zone history", zone.history.data(), static_cast<int>(zone.history.size()), static_cast<int>(zone.history_offset), fmt::format("peak {:.3f} ms", zone.peak).c_str(), 0.f, std::max(zone.peak * 1.2f, 0.01f), ImVec2(0.f, 80.f));
             }
         }
 
@@ -2,13 +2,18 @@
 
 #include "cleanup.hpp"
 #include "camera.hpp"
+#include "culling.hpp"
 #include "light.hpp"
-#include "boids.hpp"
+#include "device_allocator.hpp"
+#include "dynamic_resolution.hpp"
+#include "gpu_profiler.hpp"
+#include "flock.hpp"
 
 #include <Volk/volk.h>
 #include <GLFW/glfw3.h>
 
 #include <array>
+#include <functional>
 #include <span>
 
 namespace gui
@@ -22,9 +27,29 @@ namespace gui
         float& alignment_weight;
         float& visual_range;
         float& wall_force_weight;
-        std::span<boids::boid>& cones;
+        float& tick_rate;
+        uint32_t& instances_count;
+        uint32_t max_instances_count;
+        // past it the simulation falls behind quadratically, 0 without such a limit
+        uint32_t recommended_instances_count;
+        // projected cone radius in pixels below which the next lod is drawn
+        std::array<float, culling::lod_count - 1>& lod_thresholds;
+        // feature bits of the pipeline variants drawn
+        uint32_t& cone_variant;
+        uint32_t& grid_variant;
+        // picked from supported_sample_counts
+        VkSampleCountFlagBits& msaa_samples;
+        std::span<const VkSampleCountFlagBits> supported_sample_counts;
+        resolution::settings& resolution;
+        // what the scene is rendered at before the upscale
+        VkExtent2D render_extent;
+        // what's drawn this frame, color edits go through set_color - the flock may belong to the simulation thread
+        const boids::flock* cones;
+        std::function<void(std::size_t, const glm::vec4&)> set_color;
         std::vector<directional_light>& dir_lights;
         std::vector<point_light>& point_lights;
+        const memory::device_allocator& device_memory;
+        const profiling::gpu_profiler& gpu_profiler;
     };
 
     VkDescriptorPool create_descriptor_pool(VkDevice logical_device, cleanup::queue_type& cleanup_queue);
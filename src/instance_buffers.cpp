@@ -0,0 +1,141 @@
+#include "instance_buffers.hpp"
+#include "setup.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace boids
+{
+    namespace
+    {
+        // don't bother reallocating for the first few spawns
+        constexpr auto min_capacity = std::size_t{ 1024 };
+
+        void memory_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stages, VkAccessFlags src_access, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+        {
+            const auto barrier = VkMemoryBarrier{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = src_access,
+                .dstAccessMask = dst_access
+            };
+            vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+    }
+
+    instance_buffers::instance_buffers(VkDevice logical_device, memory::device_allocator& allocator, std::size_t frames_in_flight, std::size_t storage_alignment, bool device_state, bool staged)
+        : _device(logical_device), _allocator(allocator), _frames_in_flight(frames_in_flight), _storage_alignment(storage_alignment), _device_state(device_state), _staged(staged)
+    {
+    }
+
+    instance_buffers::~instance_buffers()
+    {
+        clear();
+    }
+
+    void instance_buffers::reserve(std::size_t count, VkCommandBuffer command_buffer, std::size_t state_index, std::size_t preserved_count, uint64_t frame, cleanup::deferred_queue& retired)
+    {
+        if (count <= _capacity)
+        {
+            return;
+        }
+
+        const auto capacity = std::max({ count, 2 * _capacity, min_capacity });
+        auto cleanup_queue = cleanup::queue_type{};
+
+        // the gpu path only draws from the state buffers, a device local copy would never be read
+        const auto frame_buffer = staging::create_frame_buffer(_device, _allocator, _frames_in_flight, capacity * sizeof(instance), _storage_alignment, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, _staged && !_device_state, memory::strategy::general, cleanup_queue);
+
+        auto state_buffers = std::array<VkBuffer, 2>{};
+        auto velocity_buffers = std::array<VkBuffer, 2>{};
+        if (_device_state)
+        {
+            for (auto& state_buffer : state_buffers)
+            {
+                state_buffer = std::get<0>(create_buffer(_device, _allocator, capacity * sizeof(instance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cleanup_queue));
+            }
+            for (auto& velocity_buffer : velocity_buffers)
+            {
+                velocity_buffer = std::get<0>(create_buffer(_device, _allocator, capacity * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cleanup_queue));
+            }
+
+            // carry the simulation over on the gpu, the old buffers stay alive until frames using them are done
+            if (preserved_count > 0 && _state_buffers[state_index] != VK_NULL_HANDLE)
+            {
+                memory_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+                // the previous state too, triangle.vert interpolates from it
+                const auto state_region = VkBufferCopy{
+                    .srcOffset = 0,
+                    .dstOffset = 0,
+                    .size = preserved_count * sizeof(instance)
+                };
+                for (std::size_t i = 0; i < state_buffers.size(); ++i)
+                {
+                    vkCmdCopyBuffer(command_buffer, _state_buffers[i], state_buffers[i], 1, &state_region);
+                }
+
+                const auto velocity_region = VkBufferCopy{
+                    .srcOffset = 0,
+                    .dstOffset = 0,
+                    .size = preserved_count * sizeof(glm::vec4)
+                };
+                vkCmdCopyBuffer(command_buffer, _velocity_buffers[state_index], velocity_buffers[state_index], 1, &velocity_region);
+
+                memory_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+            }
+        }
+
+        spdlog::info("Instance buffers grown from {} to {} boids.", _capacity, capacity);
+
+        retired.push(frame, std::move(_cleanup_queue));
+        _cleanup_queue = std::move(cleanup_queue);
+
+        _capacity = capacity;
+        _frame_buffer = frame_buffer;
+        _state_buffers = state_buffers;
+        _velocity_buffers = velocity_buffers;
+    }
+
+    std::span<instance> instance_buffers::frame_data(std::size_t frame_index, std::size_t count) const
+    {
+        assert(count <= _capacity);
+        return std::span(reinterpret_cast<instance*>(_frame_buffer.data(frame_index)), count);
+    }
+
+    VkDescriptorBufferInfo instance_buffers::frame_buffer_info(std::size_t frame_index) const
+    {
+        return _frame_buffer.buffer_info(frame_index);
+    }
+
+    void instance_buffers::upload_state(VkCommandBuffer command_buffer, std::size_t frame_index, std::size_t first, std::size_t last) const
+    {
+        assert(_device_state && first < last && last <= _capacity);
+
+        // the range may still be read by earlier steps and draws, even though only beyond their instance count
+        memory_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+        const auto region = VkBufferCopy{
+            .srcOffset = frame_index * _frame_buffer.slice_size + first * sizeof(instance),
+            .dstOffset = first * sizeof(instance),
+            .size = (last - first) * sizeof(instance)
+        };
+        for (const auto state_buffer : _state_buffers)
+        {
+            vkCmdCopyBuffer(command_buffer, _frame_buffer.host_buffer, state_buffer, 1, &region);
+        }
+
+        memory_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+
+    void instance_buffers::clear()
+    {
+        cleanup::flush(_cleanup_queue);
+        _capacity = 0;
+        _frame_buffer = {};
+        _state_buffers = {};
+        _velocity_buffers = {};
+    }
+}
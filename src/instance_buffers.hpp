@@ -0,0 +1,62 @@
+#pragma once
+
+#include "cleanup.hpp"
+#include "flock.hpp"
+#include "staging.hpp"
+
+#include <Volk/volk.h>
+
+#include <array>
+#include <span>
+
+namespace boids
+{
+    // Per instance buffers sized for the current flock. They grow geometrically; replaced buffers go to a deferred queue instead of waiting for the gpu.
+    //  - host visible boids::instance array, one slice per frame in flight, written by boids::pack on the cpu path and used as staging on the gpu path.
+    //    With staged the cpu path draws from a device local copy, see staging::uploader
+    //  - two device local instance buffers and two velocity buffers the compute path ping-pongs between (only with device_state)
+    class instance_buffers final
+    {
+    public:
+        instance_buffers(VkDevice logical_device, memory::device_allocator& allocator, std::size_t frames_in_flight, std::size_t storage_alignment, bool device_state, bool staged);
+        ~instance_buffers();
+
+        instance_buffers(const instance_buffers&) = delete;
+        instance_buffers(instance_buffers&&) = delete;
+        instance_buffers& operator=(const instance_buffers&) = delete;
+        instance_buffers& operator=(instance_buffers&&) = delete;
+
+        // Makes room for count boids. On reallocation the first preserved_count boids of both state_buffers() and velocity_buffers()[state_index] are copied over on the gpu,
+        // recorded into command_buffer, and the old buffers are retired at `frame`.
+        void reserve(std::size_t count, VkCommandBuffer command_buffer, std::size_t state_index, std::size_t preserved_count, uint64_t frame, cleanup::deferred_queue& retired);
+
+        // host visible slice for frame_index, `count` boids long
+        std::span<instance> frame_data(std::size_t frame_index, std::size_t count) const;
+        VkDescriptorBufferInfo frame_buffer_info(std::size_t frame_index) const;
+        const staging::frame_buffer& frame_buffer() const { return _frame_buffer; }
+
+        // Copies boids [first, last) from frame_data(frame_index) into both state_buffers(), with barriers against compute on both sides.
+        // The one not read by the next step is what triangle.vert interpolates from until a step actually runs.
+        // Velocities aren't uploaded, the next step derives them for [first, last), see spawned_first in boids.comp.
+        void upload_state(VkCommandBuffer command_buffer, std::size_t frame_index, std::size_t first, std::size_t last) const;
+        const std::array<VkBuffer, 2>& state_buffers() const { return _state_buffers; }
+        const std::array<VkBuffer, 2>& velocity_buffers() const { return _velocity_buffers; }
+
+        std::size_t capacity() const { return _capacity; }
+        void clear();
+
+    private:
+        VkDevice _device;
+        memory::device_allocator& _allocator;
+        std::size_t _frames_in_flight;
+        std::size_t _storage_alignment;
+        bool _device_state;
+        bool _staged;
+
+        std::size_t _capacity = 0;
+        staging::frame_buffer _frame_buffer;
+        std::array<VkBuffer, 2> _state_buffers = {};
+        std::array<VkBuffer, 2> _velocity_buffers = {};
+        cleanup::queue_type _cleanup_queue;
+    };
+}
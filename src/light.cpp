@@ -1,7 +1,11 @@
 #include "light.hpp"
-#include "constants.hpp"
+#include "setup.hpp"
 #include "shaders/shaders.h"
 
+#include <algorithm>
+#include <array>
+#include <random>
+
 namespace light
 {
     constexpr auto vertex_input_state = VkPipelineVertexInputStateCreateInfo{
@@ -22,31 +26,25 @@ namespace light
         .primitiveRestartEnable = VK_FALSE
     };
 
-    auto viewport = VkViewport{
-        .x = 0.f,
-        .y = 0.f,
-        .width = 0.f,
-        .height = 0.f,
-        .minDepth = 0.f,
-        .maxDepth = 1.f
-    };
-
-    auto scissors = VkRect2D{
-        .offset = VkOffset2D{
-            .x = 0,
-            .y = 0,
-        },
-        .extent = {}
-    };
-
     const auto viewport_state = VkPipelineViewportStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
         .viewportCount = 1,
-        .pViewports = &viewport,
+        .pViewports = nullptr, // dynamic
         .scissorCount = 1,
-        .pScissors = &scissors,
+        .pScissors = nullptr, // dynamic
+    };
+
+    // set every frame, resizing doesn't touch the pipeline
+    constexpr auto dynamic_states = std::array{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    const auto dynamic_state = VkPipelineDynamicStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+        .pDynamicStates = dynamic_states.data()
     };
 
     constexpr auto rasterization_state = VkPipelineRasterizationStateCreateInfo{
@@ -65,18 +63,6 @@ namespace light
         .lineWidth = 2.f
     };
 
-    constexpr auto multisample_state = VkPipelineMultisampleStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .rasterizationSamples = msaa_samples,
-        .sampleShadingEnable = VK_FALSE,
-        .minSampleShading = 1.f,
-        .pSampleMask = nullptr,
-        .alphaToCoverageEnable = VK_FALSE,
-        .alphaToOneEnable = VK_FALSE
-    };
-
     constexpr auto depth_stencil_state = VkPipelineDepthStencilStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
         .pNext = nullptr,
@@ -114,7 +100,34 @@ namespace light
         .blendConstants = {0.f, 0.f, 0.f, 0.f}
     };
 
-    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, const VkExtent2D& window_extent, shaders::module_cache& shaders_cache)
+    void spawn_point_lights(std::vector<point_light>& lights, std::size_t count, const glm::vec3& min_range, const glm::vec3& max_range)
+    {
+        auto rd = std::random_device{};
+        auto gen = std::mt19937(rd());
+        auto color_dis = std::uniform_real_distribution<float>(0.f, 1.f);
+        auto x_dis = std::uniform_real_distribution<float>(min_range.x, max_range.x);
+        auto y_dis = std::uniform_real_distribution<float>(min_range.y, max_range.y);
+        auto z_dis = std::uniform_real_distribution<float>(min_range.z, max_range.z);
+
+        count = std::min(count, max_point_lights - std::min(lights.size(), max_point_lights));
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto color = glm::vec3(color_dis(gen), color_dis(gen), color_dis(gen));
+            color /= std::max({ color.r, color.g, color.b, 0.01f });
+            lights.push_back(point_light{
+                .position = glm::vec4(x_dis(gen), y_dis(gen), z_dis(gen), 0.f),
+                .ambient = glm::vec4(color * 0.05f, 1.f),
+                .diffuse = glm::vec4(color, 1.f),
+                .specular = glm::vec4(color, 1.f),
+                // about 12 units of range
+                .constant = 1.f,
+                .linear = 0.7f,
+                .quadratic = 1.8f
+            });
+        }
+    }
+
+    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkSampleCountFlagBits samples, shaders::module_cache& shaders_cache)
     {
         static const auto shader_stages = std::array{
             VkPipelineShaderStageCreateInfo{
@@ -137,11 +150,6 @@ namespace light
             }
         };
 
-        viewport.width = window_extent.width;
-        viewport.height = window_extent.height;
-
-        scissors.extent = window_extent;
-
         const auto create_info = VkGraphicsPipelineCreateInfo{
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
             .pNext = nullptr,
@@ -153,10 +161,10 @@ namespace light
             .pTessellationState = nullptr,
             .pViewportState = &viewport_state,
             .pRasterizationState = &rasterization_state,
-            .pMultisampleState = &multisample_state,
+            .pMultisampleState = &get_multisample_state(samples),
             .pDepthStencilState = &depth_stencil_state,
             .pColorBlendState = &color_blend_state,
-            .pDynamicState = nullptr,
+            .pDynamicState = &dynamic_state,
             .layout = pipeline_layout,
             .renderPass = render_pass,
             .subpass = 0,
@@ -32,5 +32,13 @@ struct point_light
 
 namespace light
 {
-    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, const VkExtent2D& window_extent, shaders::module_cache& shaders_cache);
+    // point light buffers are sized for this many, light_clusters.comp handles hundreds without every fragment paying for them
+    constexpr auto max_point_lights = std::size_t{ 1024 };
+    // what the cone pipeline loops over at most, MAX_DIRECTIONAL_LIGHTS in triangle.frag
+    constexpr auto max_directional_lights = std::size_t{ 4 };
+
+    // dim random colors, short range - for stress testing the clustered lighting
+    void spawn_point_lights(std::vector<point_light>& lights, std::size_t count, const glm::vec3& min_range, const glm::vec3& max_range);
+
+    VkGraphicsPipelineCreateInfo get_pipeline_create_info(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkSampleCountFlagBits samples, shaders::module_cache& shaders_cache);
 }
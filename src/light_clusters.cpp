@@ -0,0 +1,197 @@
+#include "light_clusters.hpp"
+#include "setup.hpp"
+#include "vkcheck.hpp"
+
+#include <shaders/shaders.h>
+
+#include <array>
+#include <cmath>
+
+namespace clustering
+{
+    namespace
+    {
+        // local_size_x in light_clusters.comp
+        constexpr auto workgroup_size = uint32_t{ 64 };
+        constexpr auto cluster_size = (1 + max_lights_per_cluster) * sizeof(uint32_t);
+
+        VkDescriptorSetLayout create_descriptor_set_layout(VkDevice logical_device, cleanup::queue_type& cleanup_queue)
+        {
+            auto bindings = std::array<VkDescriptorSetLayoutBinding, 2>{};
+            for (uint32_t i = 0; i < bindings.size(); ++i)
+            {
+                bindings[i] = VkDescriptorSetLayoutBinding{
+                    .binding = i,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptorCount = 1,
+                    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .pImmutableSamplers = nullptr
+                };
+            }
+
+            const auto create_info = VkDescriptorSetLayoutCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .bindingCount = bindings.size(),
+                .pBindings = bindings.data()
+            };
+
+            auto layout = VkDescriptorSetLayout{};
+            VK_CHECK(vkCreateDescriptorSetLayout(logical_device, &create_info, nullptr, &layout));
+
+            cleanup_queue.push([logical_device, layout]() { vkDestroyDescriptorSetLayout(logical_device, layout, nullptr); });
+
+            return layout;
+        }
+
+        VkPipelineLayout create_pipeline_layout(VkDevice logical_device, VkDescriptorSetLayout set_layout, cleanup::queue_type& cleanup_queue)
+        {
+            const auto push_constant_range = VkPushConstantRange{
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(push_constants)
+            };
+
+            const auto create_info = VkPipelineLayoutCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .setLayoutCount = 1,
+                .pSetLayouts = &set_layout,
+                .pushConstantRangeCount = 1,
+                .pPushConstantRanges = &push_constant_range
+            };
+
+            auto pipeline_layout = VkPipelineLayout{};
+            VK_CHECK(vkCreatePipelineLayout(logical_device, &create_info, nullptr, &pipeline_layout));
+
+            cleanup_queue.push([logical_device, pipeline_layout]() { vkDestroyPipelineLayout(logical_device, pipeline_layout, nullptr); });
+
+            return pipeline_layout;
+        }
+
+        VkPipeline create_pipeline(VkDevice logical_device, VkPipelineLayout pipeline_layout, VkPipelineCache pipeline_cache, shaders::module_cache& shaders_cache, cleanup::queue_type& cleanup_queue)
+        {
+            const auto create_info = VkComputePipelineCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .stage = VkPipelineShaderStageCreateInfo{
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = shaders_cache.get_module(shader_path::compute::light_clusters),
+                    .pName = shader_entry_point.data(),
+                    .pSpecializationInfo = nullptr
+                },
+                .layout = pipeline_layout,
+                .basePipelineHandle = VK_NULL_HANDLE,
+                .basePipelineIndex = 0
+            };
+
+            auto pipeline = VkPipeline{};
+            VK_CHECK(vkCreateComputePipelines(logical_device, pipeline_cache, 1, &create_info, nullptr, &pipeline));
+
+            cleanup_queue.push([logical_device, pipeline]() { vkDestroyPipeline(logical_device, pipeline, nullptr); });
+
+            return pipeline;
+        }
+    }
+
+    push_constants make_push_constants(const glm::mat4& view, const glm::mat4& projection, float z_near, float z_far, uint32_t light_count)
+    {
+        return push_constants{
+            .view = view,
+            // flip_clip_space turns y around after the projection
+            .projection_scale = glm::vec2(1.f / projection[0][0], -1.f / projection[1][1]),
+            .z_near = z_near,
+            .z_far = z_far,
+            .light_count = light_count
+        };
+    }
+
+    fragment_lookup make_fragment_lookup(const glm::mat4& view, VkExtent2D extent, float z_near, float z_far)
+    {
+        const auto log_depth_ratio = std::log(z_far / z_near);
+        return fragment_lookup{
+            // in front of the camera is -z in view space
+            .depth_plane = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]),
+            .cluster_scale = glm::vec4(
+                static_cast<float>(grid_x) / extent.width,
+                static_cast<float>(grid_y) / extent.height,
+                grid_z / log_depth_ratio,
+                -(grid_z * std::log(z_near)) / log_depth_ratio)
+        };
+    }
+
+    light_clusters::light_clusters(VkDevice logical_device, memory::device_allocator& allocator, VkPipelineCache pipeline_cache, shaders::module_cache& shaders_cache, VkDescriptorPool descriptor_pool, std::size_t frames_in_flight, cleanup::queue_type& cleanup_queue)
+        : _device(logical_device),
+        _set_layout(create_descriptor_set_layout(logical_device, cleanup_queue)),
+        _pipeline_layout(create_pipeline_layout(logical_device, _set_layout, cleanup_queue)),
+        _pipeline(create_pipeline(logical_device, _pipeline_layout, pipeline_cache, shaders_cache, cleanup_queue)),
+        _descriptor_sets(frames_in_flight),
+        _cluster_buffers(frames_in_flight)
+    {
+        const auto set_layouts = std::vector<VkDescriptorSetLayout>(frames_in_flight, _set_layout);
+        const auto allocate_info = VkDescriptorSetAllocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = static_cast<uint32_t>(set_layouts.size()),
+            .pSetLayouts = set_layouts.data()
+        };
+        VK_CHECK(vkAllocateDescriptorSets(_device, &allocate_info, _descriptor_sets.data()));
+
+        for (auto& cluster_buffer : _cluster_buffers)
+        {
+            cluster_buffer = std::get<0>(create_buffer(_device, allocator, cluster_count * cluster_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cleanup_queue, memory::strategy::linear));
+        }
+    }
+
+    void light_clusters::record(VkCommandBuffer command_buffer, std::size_t frame_index, const VkDescriptorBufferInfo& point_lights, const push_constants& params)
+    {
+        const auto descriptor_set = _descriptor_sets[frame_index];
+        const auto buffer_infos = std::array{
+            point_lights,
+            buffer_info(frame_index)
+        };
+        const auto write = VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = nullptr,
+            .dstSet = descriptor_set,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = buffer_infos.size(),
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pImageInfo = nullptr,
+            .pBufferInfo = buffer_infos.data(),
+            .pTexelBufferView = nullptr
+        };
+        vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+        // the frame's previous clusters were read behind its fence, the lights are made visible by the uploader
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+        vkCmdPushConstants(command_buffer, _pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(command_buffer, static_cast<uint32_t>((cluster_count + workgroup_size - 1) / workgroup_size), 1, 1);
+
+        const auto barrier = VkMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    VkDescriptorBufferInfo light_clusters::buffer_info(std::size_t frame_index) const
+    {
+        return VkDescriptorBufferInfo{
+            .buffer = _cluster_buffers[frame_index],
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        };
+    }
+}
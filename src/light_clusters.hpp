@@ -0,0 +1,70 @@
+#pragma once
+
+#include "cleanup.hpp"
+#include "device_allocator.hpp"
+#include "shader_module_cache.hpp"
+
+#include <Volk/volk.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace clustering
+{
+    // CLUSTER_GRID_* and MAX_LIGHTS_PER_CLUSTER in light_clusters.comp and triangle.frag
+    constexpr auto grid_x = uint32_t{ 16 };
+    constexpr auto grid_y = uint32_t{ 9 };
+    constexpr auto grid_z = uint32_t{ 24 };
+    constexpr auto cluster_count = std::size_t{ grid_x * grid_y * grid_z };
+    // a count and the light indices, 256 bytes per cluster
+    constexpr auto max_lights_per_cluster = std::size_t{ 63 };
+
+    // matches Parameters block in light_clusters.comp
+    struct push_constants
+    {
+        glm::mat4 view;
+        glm::vec2 projection_scale;
+        float z_near;
+        float z_far;
+        uint32_t light_count;
+    };
+
+    // Part of CameraData, what triangle.frag needs to find its cluster.
+    struct fragment_lookup
+    {
+        // view depth = dot(depth_plane, vec4(world_pos, 1))
+        glm::vec4 depth_plane;
+        // xy: clusters per pixel, z and w: depth slice = log(depth) * z + w
+        glm::vec4 cluster_scale;
+    };
+
+    push_constants make_push_constants(const glm::mat4& view, const glm::mat4& projection, float z_near, float z_far, uint32_t light_count);
+    fragment_lookup make_fragment_lookup(const glm::mat4& view, VkExtent2D extent, float z_near, float z_far);
+
+    // Assigns point lights to froxels, screen tiles split into exponential depth slices, so fragments only shade with the lights that can reach them.
+    // One cluster list buffer per frame, read by the same frame's fragment shaders.
+    class light_clusters final
+    {
+    public:
+        light_clusters(VkDevice logical_device, memory::device_allocator& allocator, VkPipelineCache pipeline_cache, shaders::module_cache& shaders_cache, VkDescriptorPool descriptor_pool, std::size_t frames_in_flight, cleanup::queue_type& cleanup_queue);
+
+        light_clusters(const light_clusters&) = delete;
+        light_clusters(light_clusters&&) = delete;
+        light_clusters& operator=(const light_clusters&) = delete;
+        light_clusters& operator=(light_clusters&&) = delete;
+
+        // Records the assignment outside a render pass, point_lights has to be uploaded already. Ends with a barrier against fragment shaders reading the clusters.
+        void record(VkCommandBuffer command_buffer, std::size_t frame_index, const VkDescriptorBufferInfo& point_lights, const push_constants& params);
+
+        // bound as ClustersData to triangle.frag
+        VkDescriptorBufferInfo buffer_info(std::size_t frame_index) const;
+
+    private:
+        VkDevice _device;
+        VkDescriptorSetLayout _set_layout;
+        VkPipelineLayout _pipeline_layout;
+        VkPipeline _pipeline;
+        std::vector<VkDescriptorSet> _descriptor_sets;
+        std::vector<VkBuffer> _cluster_buffers;
+    };
+}
@@ -1,16 +1,30 @@
 #include "camera.hpp"
+#include "cli.hpp"
 #include "cleanup.hpp"
 #include "setup.hpp"
 #include "vkcheck.hpp"
 #include "boids.hpp"
+#include "boids_compute.hpp"
+#include "fixed_timestep.hpp"
+#include "flock.hpp"
+#include "instance_buffers.hpp"
+#include "device_allocator.hpp"
+#include "simulation_thread.hpp"
+#include "steer_kernels.hpp"
 #include "light.hpp"
+#include "staging.hpp"
 #include "cone.hpp"
 #include "aquarium.hpp"
-#include "constants.hpp"
 #include "grid.hpp"
 #include "gui.hpp"
 #include "shader_module_cache.hpp"
-#include "constants.hpp"
+#include "pipeline_cache.hpp"
+#include "gpu_profiler.hpp"
+#include "cpu_profiler.hpp"
+#include "culling.hpp"
+#include "pipeline_variants.hpp"
+#include "light_clusters.hpp"
+#include "dynamic_resolution.hpp"
 
 #include <glm/glm.hpp>
 #include <spdlog/spdlog.h>
@@ -18,6 +32,12 @@
 
 #include <vector>
 #include <array>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
 
 constexpr bool VALIDATION_LAYERS = true;
 
@@ -27,7 +47,11 @@ glm::vec2 gui_mode_mouse_pos{};
 const auto flip_clip_space = glm::scale(glm::mat4(1.), glm::vec3(1, -1, 1));
 
 auto general_queue = cleanup::queue_type{};
+// the scene render pass and its pipelines, replaced when the msaa level changes
+auto render_pass_queue = cleanup::queue_type{};
 auto swapchain_queue = cleanup::queue_type{};
+// render target, multisampled attachments and scene framebuffers, replaced on resize and when the msaa level changes
+auto framebuffer_queue = cleanup::queue_type{};
 
 auto visual_range = 1.f;
 auto cohesion_weight = 0.001f;
@@ -36,16 +60,23 @@ auto alignment_weight = 0.001f;
 auto wall_force_weight = 0.1f;
 
 auto model_speed = 0.1f;
-auto model_scale = glm::vec3(0.5, 0.5, 0.5);
+auto model_scale = 0.5f;
+// simulation ticks per second, the boid params are per tick
+auto tick_rate = 60.f;
+// catching up on more than this per frame would only make the next frame slower still
+constexpr auto max_ticks_per_frame = uint32_t{ 4 };
 
-namespace aquarium
-{
-    constexpr float scale = 30.f;
-    const auto min_range = glm::vec3(-scale, 0.f, -scale);
-    const auto max_range = glm::vec3(scale, scale, scale);
+// base vertices of each cone lod, most detailed first
+constexpr auto cone_lod_segments = std::array<uint32_t, culling::lod_count>{ 12, 8, 5, 3 };
+// projected cone radius in pixels below which the next lod is drawn
+auto lod_thresholds = std::array<float, culling::lod_count - 1>{ 40.f, 15.f, 5.f };
 
-    const auto wall_repellents = get_wall_repellents(min_range, max_range, wall_force_weight);
-}
+// scene render scale, changed from the gui
+auto resolution_settings = resolution::settings{};
+
+// feature bits of the pipeline variants drawn, toggled from the gui
+auto cone_variant = cone::all_features;
+auto grid_variant = grid::all_features;
 
 struct lights_data
 {
@@ -145,32 +176,96 @@ void handle_keyboard(GLFWwindow* window, camera& camera)
     }
 }
 
-auto recreate_graphics_pipeline_and_swapchain(GLFWwindow* window, VkDevice logical_device, VkPhysicalDevice physical_device, shaders::module_cache& shaders_cache, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkSurfaceKHR surface, uint32_t queue_family_index, VkFormat swapchain_format, cleanup::queue_type& cleanup_queue)
+// everything that depends on the window size, pipelines use dynamic viewport and scissor and outlive it
+auto create_swapchain_objects(GLFWwindow* window, VkDevice logical_device, VkPhysicalDevice physical_device, VkRenderPass gui_render_pass, VkSurfaceKHR surface, uint32_t queue_family_index, VkSwapchainKHR old_swapchain, cleanup::queue_type& cleanup_queue)
 {
     const auto window_extent = window::get_extent(window);
     spdlog::info("New extent: {}, {}", window_extent.width, window_extent.height);
 
-    auto graphics_pipelines = create_graphics_pipelines(logical_device, {
-        cone::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, window_extent, shaders_cache),
-        grid::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, window_extent, shaders_cache),
-        aquarium::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, window_extent, shaders_cache),
-        light::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, window_extent, shaders_cache),
-    }, cleanup_queue);
-    const auto& [swapchain, surface_format] = create_swapchain(logical_device, physical_device, surface, queue_family_index, window_extent, cleanup_queue);
+    const auto& [swapchain, surface_format] = create_swapchain(logical_device, physical_device, surface, queue_family_index, window_extent, old_swapchain, cleanup_queue);
     const auto& [swapchain_images, swapchain_image_views] = get_swapchain_images(logical_device, swapchain, surface_format.format, cleanup_queue);
+    const auto gui_framebuffers = create_gui_framebuffers(logical_device, gui_render_pass, swapchain_image_views, window_extent, cleanup_queue);
 
-    auto [color_image, color_image_view, color_image_memory] = create_color_image(logical_device, physical_device, swapchain_format, window_extent, cleanup_queue);
-    auto [depth_image, depth_image_view, depth_image_memory] = create_depth_image(logical_device, physical_device, window_extent, cleanup_queue);
+    return std::tuple{ window_extent, swapchain, surface_format, swapchain_images, swapchain_image_views, gui_framebuffers };
+}
 
-    const auto swapchain_framebuffers = create_swapchain_framebuffers(logical_device, render_pass, { color_image_view }, swapchain_image_views, { depth_image_view }, window_extent, cleanup_queue);
+// the scene framebuffers and their attachments, no multisampled color image at 1x. All at window size, the scene uses part of them when scaled down
+auto create_framebuffer_objects(VkDevice logical_device, memory::device_allocator& allocator, VkRenderPass render_pass, VkFormat swapchain_format, VkFormat depth_format, VkSampleCountFlagBits samples, const std::vector<VkImageView>& swapchain_image_views, VkExtent2D window_extent, cleanup::queue_type& cleanup_queue)
+{
+    assert(swapchain_image_views.size() == 1); // TODO create color images per each swapchain image?
+
+    const auto [render_target, render_target_view, render_target_memory] = create_render_target(logical_device, allocator, swapchain_format, window_extent, cleanup_queue);
+    auto color_image_views = std::vector<VkImageView>{};
+    // the render target is stored for the upscale, the rest is DONT_CARE
+    auto attachment_memory = std::vector<memory::allocation>{};
+    if (samples != VK_SAMPLE_COUNT_1_BIT)
+    {
+        const auto [color_image, color_image_view, color_image_memory] = create_color_image(logical_device, allocator, swapchain_format, window_extent, samples, cleanup_queue);
+        color_image_views.push_back(color_image_view);
+        attachment_memory.push_back(color_image_memory);
+    }
+    const auto [depth_image, depth_image_view, depth_image_memory] = create_depth_image(logical_device, allocator, depth_format, window_extent, samples, cleanup_queue);
+    attachment_memory.push_back(depth_image_memory);
+    log_attachment_footprint(allocator, window_extent, attachment_memory, std::span(&render_target_memory, 1));
 
-    return std::tuple{ graphics_pipelines, window_extent, swapchain, surface_format, swapchain_images, swapchain_image_views, swapchain_framebuffers, color_image, color_image_memory, color_image_view, depth_image, depth_image_view, depth_image_memory };
+    const auto framebuffers = create_scene_framebuffers(logical_device, render_pass, color_image_views, { render_target_view }, { depth_image_view }, window_extent, cleanup_queue);
+    return std::tuple{ framebuffers, render_target };
 }
 
-int main()
+int main(int argc, char** argv)
 {
     spdlog::set_level(spdlog::level::trace);
     spdlog::info("Start");
+
+    const auto hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    // a few workers per core can still help when some of them get descheduled, thousands only contend and take ages to start
+    const auto max_simulation_threads = uint64_t{ 4 } * hardware_threads;
+    auto simulation_threads = cli::uint_option(argc, argv, "--threads", hardware_threads);
+    if (simulation_threads == 0)
+    {
+        // the count includes the calling thread, there's always at least that one
+        spdlog::warn("--threads 0 is not a thread count, using 1.");
+        simulation_threads = 1;
+    }
+    else if (simulation_threads > max_simulation_threads)
+    {
+        spdlog::warn("--threads {} is far more than the {} hardware threads, using {}.", simulation_threads, hardware_threads, max_simulation_threads);
+        simulation_threads = max_simulation_threads;
+    }
+    spdlog::info("Simulation threads: {}", simulation_threads);
+    if (const auto kernel_option = cli::find_option(argc, argv, "--kernel"))
+    {
+        const auto kernel = boids::kernels::from_name(*kernel_option);
+        if (!kernel || !boids::kernels::select(*kernel))
+        {
+            spdlog::warn("Steering kernel {} is not supported on this cpu.", *kernel_option);
+        }
+    }
+    spdlog::info("Steering kernel: {}", boids::kernels::name(boids::kernels::active_isa()));
+    const auto gpu_simulation = cli::find_option(argc, argv, "--simulation") == "gpu";
+    spdlog::info("Simulation runs on {}", gpu_simulation ? "gpu" : "cpu");
+    tick_rate = std::max(cli::float_option(argc, argv, "--tick-rate", tick_rate), 1.f);
+    spdlog::info("Simulation tick rate: {} Hz", tick_rate);
+
+    // e.g. --trace-frames 100:120, zones are only recorded for those frames
+    const auto trace_frames_option = cli::find_option(argc, argv, "--trace-frames");
+    const auto trace_path = std::filesystem::path(cli::find_option(argc, argv, "--trace-file").value_or("trace.json"));
+    auto trace_capture = std::optional<profiling::frame_capture>{};
+    if (trace_frames_option)
+    {
+        const auto separator = trace_frames_option->find(':');
+        const auto first_frame = cli::parse_uint(trace_frames_option->substr(0, separator));
+        const auto last_frame = separator != std::string_view::npos ? cli::parse_uint(trace_frames_option->substr(separator + 1)) : first_frame;
+        if (first_frame && last_frame)
+        {
+            trace_capture.emplace(*first_frame, std::max(*first_frame, *last_frame), trace_path);
+            profiling::set_thread_name("render");
+        }
+        else
+        {
+            spdlog::warn("Ignoring --trace-frames {}, expected a frame or a range like 100:120.", *trace_frames_option);
+        }
+    }
     VK_CHECK(volkInitialize());
 
     const auto window = window::create(general_queue, mouse_callback, key_callback);
@@ -198,34 +293,76 @@ int main()
     const auto surface = window::create_vk_surface(vk_instance, window, general_queue);
 
     const auto& [physical_device, queue_family_index, physical_device_properties] = pick_physical_device(vk_instance, surface, required_device_extensions);
-    const auto& [logical_device, present_queue] = create_logical_device(physical_device, queue_family_index, required_device_extensions, general_queue);
+    // shaders read per frame data straight from host memory on unified memory, elsewhere it goes through staging::uploader, on a transfer only queue when there is one
+    const auto staged_uploads = !staging::is_unified_memory(physical_device_properties);
+    const auto transfer_queue_family_index = staged_uploads ? pick_family_index(VK_QUEUE_TRANSFER_BIT, get_queue_family_properties(physical_device), VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT) : std::nullopt;
+    spdlog::info("Per frame uploads: {}.", !staged_uploads ? "host visible buffers" : transfer_queue_family_index ? "staged on a dedicated transfer queue" : "staged on the graphics queue");
+
+    const auto& [logical_device, present_queue, transfer_queue] = create_logical_device(physical_device, queue_family_index, transfer_queue_family_index, required_device_extensions, general_queue);
+
+    // everything allocated later is freed before the blocks go
+    auto allocator = memory::device_allocator(logical_device, physical_device);
+    general_queue.push([&allocator]() { allocator.clear(); });
 
     auto window_extent = window::get_extent(window);
 
-    auto [swapchain, surface_format] = create_swapchain(logical_device, physical_device, surface, queue_family_index, window_extent, swapchain_queue);
+    auto [swapchain, surface_format] = create_swapchain(logical_device, physical_device, surface, queue_family_index, window_extent, VK_NULL_HANDLE, swapchain_queue);
     auto [swapchain_images, swapchain_image_views] = get_swapchain_images(logical_device, swapchain, surface_format.format, swapchain_queue);
 
-    const auto render_pass = create_render_pass(logical_device, surface_format.format, depth_format, msaa_samples, general_queue);
+    const auto gui_render_pass = create_gui_render_pass(logical_device, surface_format.format, general_queue);
+    auto gui_framebuffers = create_gui_framebuffers(logical_device, gui_render_pass, swapchain_image_views, window_extent, swapchain_queue);
+
+    const auto supported_sample_counts = get_supported_sample_counts(physical_device_properties);
+    const auto depth_format = choose_depth_format(physical_device);
+    // the most the device takes, up to 8x. Changed from the gui, the scene pass follows at the start of the next frame
+    auto msaa_samples = supported_sample_counts.back();
+    spdlog::info("Depth format {}, up to {}x msaa.", static_cast<int>(depth_format), static_cast<int>(msaa_samples));
+
     const auto descriptor_set_layout = create_descriptor_sets_layouts(logical_device, general_queue);
     const auto pipeline_layout = create_pipeline_layout(logical_device, { descriptor_set_layout }, general_queue);
 
     auto shader_cache = shaders::module_cache(logical_device);
     general_queue.push([&shader_cache]() { shader_cache.clear(); });
 
-    auto graphics_pipelines = create_graphics_pipelines(logical_device, {
-        cone::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, window_extent, shader_cache),
-        grid::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, window_extent, shader_cache),
-        aquarium::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, window_extent, shader_cache),
-        light::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, window_extent, shader_cache),
-    }, swapchain_queue);
-
-    auto& cone_pipeline = graphics_pipelines[0];
-    auto& grid_pipeline = graphics_pipelines[1];
-    auto& aquarium_pipeline = graphics_pipelines[2];
-    auto& debug_cube_pipeilne = graphics_pipelines[3];
+    // saved on exit, after every pipeline using it is gone
+    auto pipeline_cache = pipelines::disk_cache(logical_device, physical_device_properties, "pipeline_cache.bin");
+    general_queue.push([&pipeline_cache]() {
+        pipeline_cache.save();
+        pipeline_cache.clear();
+    });
 
     constexpr auto overlapping_frames_count = 2;
 
+    auto gpu_profiler = profiling::gpu_profiler(logical_device, physical_device_properties, get_queue_family_properties(physical_device)[queue_family_index].timestampValidBits, overlapping_frames_count, general_queue);
+
+    // the scene pass and everything drawn in it depend on the sample count
+    auto render_pass = VkRenderPass{};
+    auto render_pass_samples = msaa_samples;
+    auto aquarium_pipeline = VkPipeline{};
+    auto debug_cube_pipeilne = VkPipeline{};
+    auto cone_pipelines = std::optional<pipelines::variants>{};
+    auto grid_pipelines = std::optional<pipelines::variants>{};
+    const auto create_scene_pipelines = [&](VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue) {
+        const auto pipelines_start = std::chrono::steady_clock::now();
+        render_pass = create_render_pass(logical_device, surface_format.format, depth_format, samples, cleanup_queue);
+        render_pass_samples = samples;
+        const auto graphics_pipelines = create_graphics_pipelines(logical_device, pipeline_cache.handle(), {
+            aquarium::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, samples, shader_cache),
+            light::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, samples, shader_cache),
+        }, cleanup_queue);
+        aquarium_pipeline = graphics_pipelines[0];
+        debug_cube_pipeilne = graphics_pipelines[1];
+        // every variant up front, toggling a feature only binds another pipeline
+        cone_pipelines.emplace(logical_device, pipeline_cache.handle(), cone::variant_count, [&](uint32_t variant) {
+            return cone::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, samples, shader_cache, variant);
+        }, cleanup_queue);
+        grid_pipelines.emplace(logical_device, pipeline_cache.handle(), grid::variant_count, [&](uint32_t index) {
+            return grid::get_pipeline_create_info(logical_device, pipeline_layout, render_pass, samples, shader_cache, grid::variants[index]);
+        }, cleanup_queue);
+        pipeline_cache.report("Graphics pipelines", std::chrono::steady_clock::now() - pipelines_start);
+    };
+    create_scene_pipelines(msaa_samples, render_pass_queue);
+
     const auto descriptor_pool = create_descriptor_pool(logical_device,  general_queue);
     const auto descriptor_sets = allocate_descriptor_sets(logical_device, { descriptor_set_layout }, descriptor_pool, overlapping_frames_count);
     const auto descriptor_update_template = create_descriptor_update_template(logical_device, descriptor_set_layout, pipeline_layout, general_queue);
@@ -234,62 +371,111 @@ int main()
     {
         glm::vec4 position;
         glm::mat4 viewproj;
+        clustering::fragment_lookup clusters;
     } camera_data;
 
-    constexpr auto instances_count = 100;
-    auto model_data = std::array<boids::boid, instances_count>();
-    auto model_data_update_buffer = std::vector<boids::boid>(instances_count);
+    // changed at runtime from the gui, flock and instance buffers follow at the start of the next frame
+    const auto max_instances_count = static_cast<uint32_t>(physical_device_properties.limits.maxStorageBufferRange / sizeof(boids::instance));
+    auto instances_count = static_cast<uint32_t>(std::min<uint64_t>(cli::uint_option(argc, argv, "--boids", 100), max_instances_count));
+    // the cpu path only looks at neighbouring cells, the gpu one at every boid
+    const auto recommended_instances_count = gpu_simulation ? boids::compute::max_recommended_count : uint32_t{ 0 };
+    if (recommended_instances_count != 0 && instances_count > recommended_instances_count)
+    {
+        spdlog::warn("The gpu simulation tests every pair of boids, {} boids won't keep up with the tick rate. It's meant for up to {}.", instances_count, recommended_instances_count);
+    }
 
-    auto model_data_span = std::span(model_data.data(), model_data.data() + instances_count);
-    cone::generate_model_data(model_data_span, aquarium::min_range, aquarium::max_range);
+    // On the cpu path the simulation thread owns the flock and the render loop draws its snapshots, gui edits are posted to it.
+    // On the gpu path the flock here only spawns boids for upload and the compute steps are paced by simulation_clock.
+    auto flock = boids::flock{};
+    auto simulation = std::optional<boids::simulation_thread>{};
+    auto simulation_clock = timing::fixed_timestep(tick_rate, max_ticks_per_frame);
+    auto posted_parameters = boids::messages::set_parameters{
+        .params = boids::parameters{
+            .visual_range = visual_range,
+            .cohesion_weight = cohesion_weight,
+            .separation_weight = separation_weight,
+            .alignment_weight = alignment_weight,
+            .speed = model_speed
+        },
+        .wall_force_weight = wall_force_weight
+    };
+    auto posted_tick_rate = tick_rate;
+    auto posted_instances_count = instances_count;
+    if (gpu_simulation)
+    {
+        flock.resize(instances_count);
+        boids::spawn(flock, aquarium::min_range, aquarium::max_range);
+    }
+    else
+    {
+        simulation.emplace(instances_count, posted_parameters.params, posted_parameters.wall_force_weight, tick_rate, simulation_threads);
+    }
 
     const auto camera_data_padded_size = pad_uniform_buffer_size(sizeof(camera_data), physical_device_properties.limits.minUniformBufferOffsetAlignment);
-    const auto& [camera_data_buffer, camera_data_memory] = create_buffer(logical_device, physical_device, overlapping_frames_count * camera_data_padded_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, general_queue);
-    void* camera_data_memory_ptr = nullptr;
-    VK_CHECK(vkMapMemory(logical_device, camera_data_memory, 0, VK_WHOLE_SIZE, 0, &camera_data_memory_ptr));
+    const auto& [camera_data_buffer, camera_data_memory] = create_buffer(logical_device, allocator, overlapping_frames_count * camera_data_padded_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, general_queue, memory::strategy::linear);
+    void* camera_data_memory_ptr = camera_data_memory.mapped;
     const auto camera_data_descriptor_buffer_infos = get_descriptor_buffer_infos(camera_data_buffer, camera_data_padded_size, overlapping_frames_count);
 
-    const auto model_data_padded_size = pad_uniform_buffer_size(sizeof(model_data), physical_device_properties.limits.minUniformBufferOffsetAlignment);
-    const auto& [model_data_buffer, model_data_memory] = create_buffer(logical_device, physical_device, overlapping_frames_count * model_data_padded_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, general_queue);
-    void* model_data_memory_ptr = nullptr;
-    VK_CHECK(vkMapMemory(logical_device, model_data_memory, 0, VK_WHOLE_SIZE, 0, &model_data_memory_ptr));
-    const auto model_data_descriptor_buffer_infos = get_descriptor_buffer_infos(model_data_buffer, model_data_padded_size, overlapping_frames_count);
+    // buffers replaced while frames are in flight
+    auto retired_objects = cleanup::deferred_queue(overlapping_frames_count);
+    general_queue.push([&retired_objects]() { retired_objects.flush(); });
 
-    const auto dir_lights_data_padded_size = pad_uniform_buffer_size(lights.dir_lights.size() * sizeof(decltype(lights.dir_lights)::value_type), physical_device_properties.limits.minUniformBufferOffsetAlignment);
-    const auto& [dir_lights_data_buffer, dir_lights_data_memory] = create_buffer(logical_device, physical_device, overlapping_frames_count * dir_lights_data_padded_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, general_queue);
-    void* dir_lights_data_memory_ptr = nullptr;
-    VK_CHECK(vkMapMemory(logical_device, dir_lights_data_memory, 0, VK_WHOLE_SIZE, 0, &dir_lights_data_memory_ptr));
-    const auto dir_lights_data_descriptor_buffer_infos = get_descriptor_buffer_infos(dir_lights_data_buffer, dir_lights_data_padded_size, overlapping_frames_count);
+    auto instance_buffers = boids::instance_buffers(logical_device, allocator, overlapping_frames_count, physical_device_properties.limits.minStorageBufferOffsetAlignment, gpu_simulation, staged_uploads);
+    general_queue.push([&instance_buffers]() { instance_buffers.clear(); });
 
-    const auto point_lights_data_padded_size = pad_uniform_buffer_size(lights.point_lights.size() * sizeof(decltype(lights.point_lights)::value_type), physical_device_properties.limits.minUniformBufferOffsetAlignment);
-    const auto& [point_lights_data_buffer, point_lights_data_memory] = create_buffer(logical_device, physical_device, overlapping_frames_count * point_lights_data_padded_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, general_queue);
-    void* point_lights_data_memory_ptr = nullptr;
-    VK_CHECK(vkMapMemory(logical_device, point_lights_data_memory, 0, VK_WHOLE_SIZE, 0, &point_lights_data_memory_ptr));
-    const auto point_lights_data_descriptor_buffer_infos = get_descriptor_buffer_infos(point_lights_data_buffer, point_lights_data_padded_size, overlapping_frames_count);
+    const auto dir_lights_data_size = lights.dir_lights.size() * sizeof(decltype(lights.dir_lights)::value_type);
+    const auto dir_lights_data = staging::create_frame_buffer(logical_device, allocator, overlapping_frames_count, dir_lights_data_size, physical_device_properties.limits.minStorageBufferOffsetAlignment, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, staged_uploads, memory::strategy::linear, general_queue);
 
-    auto [color_image, color_image_view, color_image_memory] = create_color_image(logical_device, physical_device, surface_format.format, window_extent, swapchain_queue);
-    auto [depth_image, depth_image_view, depth_image_memory] = create_depth_image(logical_device, physical_device, window_extent, swapchain_queue);
+    // room for lights spawned from the gui, only the used part is copied each frame
+    const auto point_lights_data_capacity = light::max_point_lights * sizeof(decltype(lights.point_lights)::value_type);
+    const auto point_lights_data = staging::create_frame_buffer(logical_device, allocator, overlapping_frames_count, point_lights_data_capacity, physical_device_properties.limits.minStorageBufferOffsetAlignment, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, staged_uploads, memory::strategy::linear, general_queue);
 
-    assert(swapchain_image_views.size() == 1); // TODO create color images per each swapchain image?
+    auto uploader = staging::uploader(logical_device, queue_family_index, transfer_queue_family_index, transfer_queue, overlapping_frames_count, general_queue);
 
-    auto swapchain_framebuffers = create_swapchain_framebuffers(logical_device, render_pass, { color_image_view }, swapchain_image_views, { depth_image_view }, window_extent, swapchain_queue);
+    auto [scene_framebuffers, render_target] = create_framebuffer_objects(logical_device, allocator, render_pass, surface_format.format, depth_format, msaa_samples, swapchain_image_views, window_extent, framebuffer_queue);
 
     const auto command_pool = create_command_pool(logical_device, queue_family_index, general_queue);
     const auto command_buffers = create_command_buffers(logical_device, command_pool, overlapping_frames_count, general_queue);
 
-    const auto cone_vertex_buffer = cone::generate_vertex_data();
-    const auto cone_vertex_buffer_size = cone_vertex_buffer.size() * sizeof(vertex);
-    //const auto cone_index_buffer_size = cone_index_buffer.size() * sizeof(decltype(cone_index_buffer)::value_type);
+    // gpu simulation ping-pongs between the two instance state buffers, drawing interpolates between them. New boids are spawned on the cpu and uploaded when they first show up
+    auto gpu_state = 0;
+    // boids the gpu has stepped at least once, and boids uploaded into both state buffers. The ones in between start from their direction on the next step
+    auto gpu_instances_count = std::size_t{ 0 };
+    auto gpu_uploaded_count = std::size_t{ 0 };
+
+    const auto compute_set_layout = boids::compute::create_descriptor_set_layout(logical_device, general_queue);
+    const auto compute_pipeline_layout = boids::compute::create_pipeline_layout(logical_device, compute_set_layout, general_queue);
+    const auto compute_pipeline = boids::compute::create_pipeline(logical_device, compute_pipeline_layout, pipeline_cache.handle(), shader_cache, general_queue);
+    // two per frame in flight, one for each ping-pong direction: a frame can run several ticks
+    const auto compute_descriptor_sets = boids::compute::allocate_descriptor_sets(logical_device, descriptor_pool, compute_set_layout, 2 * overlapping_frames_count);
+
+    const auto cone_lods = cone::generate_lods(cone_lod_segments);
+    const auto& cone_vertex_buffer = cone_lods.vertices;
+    const auto& cone_index_buffer = cone_lods.indices;
+    const auto cone_vertex_buffer_size = cone_vertex_buffer.size() * sizeof(packed_vertex);
+    const auto cone_index_buffer_size = cone_index_buffer.size() * sizeof(decltype(cone_index_buffer)::value_type);
+    spdlog::info("Cone lods: {} vertices, {} indices, {} bytes.", cone_vertex_buffer.size(), cone_index_buffer.size(), cone_vertex_buffer_size + cone_index_buffer_size);
+
+    // indices right after the vertices, packed_vertex keeps the offset 2 byte aligned
+    const auto& [vertex_buffer, device_memory] = create_buffer(logical_device, allocator, cone_vertex_buffer_size + cone_index_buffer_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, general_queue, memory::strategy::linear);
+    copy_memory(device_memory, 0, cone_vertex_buffer.data(), cone_vertex_buffer_size);
+    copy_memory(device_memory, cone_vertex_buffer_size, cone_index_buffer.data(), cone_index_buffer_size);
 
-    const auto& [vertex_buffer, device_memory] = create_buffer(logical_device, physical_device, cone_vertex_buffer_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, general_queue);
-    copy_memory(logical_device, device_memory, 0, cone_vertex_buffer.data(), cone_vertex_buffer_size);
-    //copy_memory(logical_device, device_memory, cone_vertex_buffer_size, cone_index_buffer.data(), cone_index_buffer_size);
+    auto culler = culling::frustum_culler(logical_device, allocator, pipeline_cache.handle(), shader_cache, descriptor_pool, overlapping_frames_count, cone_lods.lods, general_queue);
+    general_queue.push([&culler]() { culler.clear(); });
+
+    auto light_clusters = clustering::light_clusters(logical_device, allocator, pipeline_cache.handle(), shader_cache, descriptor_pool, overlapping_frames_count, general_queue);
+    const auto cone_radius = cone_lods.radius;
 
     const auto image_available_semaphores = create_semaphores(logical_device, overlapping_frames_count, general_queue);
     const auto rendering_finished_semaphores = create_semaphores(logical_device, overlapping_frames_count, general_queue);
     const auto overlapping_frames_fences = create_fences(logical_device, overlapping_frames_count, general_queue);
 
-    gui::init(window, vk_instance, logical_device, physical_device, queue_family_index, present_queue, overlapping_frames_count, render_pass, surface, surface_format, swapchain, command_pool, command_buffers[0], general_queue);
+    // fed the "Frame" gpu zone, everything up to the upscale
+    auto resolution_controller = resolution::controller{};
+    auto frame_time_samples = std::size_t{ 0 };
+
+    gui::init(window, vk_instance, logical_device, physical_device, queue_family_index, present_queue, overlapping_frames_count, gui_render_pass, surface, surface_format, swapchain, command_pool, command_buffers[0], general_queue);
 
     auto gui_data = gui::data_refs{
         .model_speed = model_speed,
@@ -299,16 +485,58 @@ int main()
         .alignment_weight = alignment_weight,
         .visual_range = visual_range,
         .wall_force_weight = wall_force_weight,
-        .cones = model_data_span,
+        .tick_rate = tick_rate,
+        .instances_count = instances_count,
+        .max_instances_count = max_instances_count,
+        .recommended_instances_count = recommended_instances_count,
+        .lod_thresholds = lod_thresholds,
+        .cone_variant = cone_variant,
+        .grid_variant = grid_variant,
+        .msaa_samples = msaa_samples,
+        .supported_sample_counts = supported_sample_counts,
+        .resolution = resolution_settings,
+        .render_extent = window_extent,
+        .cones = &flock,
+        .set_color = [&simulation, &flock](std::size_t index, const glm::vec4& color) {
+            if (simulation)
+            {
+                simulation->post(boids::messages::set_color{ .index = index, .color = color });
+            }
+            else
+            {
+                flock.colors[index] = color;
+            }
+        },
         .dir_lights = lights.dir_lights,
         .point_lights = lights.point_lights,
+        .device_memory = allocator,
+        .gpu_profiler = gpu_profiler,
     };
 
     spdlog::trace("Entering main loop.");
     auto current_frame = uint32_t{ 0 };
+    auto frame_number = uint64_t{ 0 };
     auto image_index = uint32_t{ 0 };
+    auto swapchain_outdated = false;
+    auto last_frame_time = std::chrono::steady_clock::now();
     while (!glfwWindowShouldClose(window))
     {
+        if (trace_capture)
+        {
+            if (const auto written = trace_capture->begin_frame(frame_number))
+            {
+                if (*written)
+                {
+                    spdlog::info("Trace of frames {} written to {}.", *trace_frames_option, trace_path.string());
+                }
+                else
+                {
+                    spdlog::warn("Could not write trace to {}.", trace_path.string());
+                }
+            }
+        }
+        const auto frame_zone = profiling::scoped_zone("Frame");
+
         glfwPollEvents();
         handle_keyboard(window, g_camera);
 
@@ -317,29 +545,65 @@ int main()
         const auto rendering_finished_semaphore = rendering_finished_semaphores[current_frame];
         const auto command_buffer = command_buffers[current_frame];
 
-        VK_CHECK(vkWaitForFences(logical_device, 1, &fence, VK_TRUE, UINT64_MAX));
+        {
+            const auto zone = profiling::scoped_zone("Wait for fence");
+            VK_CHECK(vkWaitForFences(logical_device, 1, &fence, VK_TRUE, UINT64_MAX));
+        }
+        retired_objects.collect(frame_number);
 
+        if (swapchain_outdated)
         {
-            const auto result = vkAcquireNextImageKHR(logical_device, swapchain, UINT64_MAX, image_available_semaphore, VK_NULL_HANDLE, &image_index);
-            if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
+            // minimized, a zero sized swapchain can't be created
+            if (const auto extent = window::get_extent(window); extent.width == 0 || extent.height == 0)
             {
-                spdlog::info("Swapchain images no longer match native surface properties. Recreating swapchain.");
-                VK_CHECK(vkDeviceWaitIdle(logical_device));
+                glfwWaitEvents();
+                continue;
+            }
+
+            spdlog::info("Swapchain images no longer match native surface properties. Recreating swapchain.");
+
+            // the other frame in flight may still render to the old objects, they're retired instead of waiting for the device
+            auto new_swapchain_queue = cleanup::queue_type{};
+            auto new_framebuffer_queue = cleanup::queue_type{};
+            std::tie(window_extent, swapchain, surface_format, swapchain_images, swapchain_image_views, gui_framebuffers) = create_swapchain_objects(window, logical_device, physical_device, gui_render_pass, surface, queue_family_index, swapchain, new_swapchain_queue);
+            std::tie(scene_framebuffers, render_target) = create_framebuffer_objects(logical_device, allocator, render_pass, surface_format.format, depth_format, render_pass_samples, swapchain_image_views, window_extent, new_framebuffer_queue);
+            retired_objects.push(frame_number, std::move(framebuffer_queue));
+            retired_objects.push(frame_number, std::move(swapchain_queue));
+            framebuffer_queue = std::move(new_framebuffer_queue);
+            swapchain_queue = std::move(new_swapchain_queue);
+            swapchain_outdated = false;
+        }
 
-                spdlog::info("Destroy swapchain objects.");
-                cleanup::flush(swapchain_queue);
+        if (msaa_samples != render_pass_samples)
+        {
+            spdlog::info("Switching to {}x msaa.", static_cast<int>(msaa_samples));
+
+            // retired like the swapchain, the swapchain itself and the gui pass don't depend on the sample count
+            auto new_render_pass_queue = cleanup::queue_type{};
+            auto new_framebuffer_queue = cleanup::queue_type{};
+            create_scene_pipelines(msaa_samples, new_render_pass_queue);
+            std::tie(scene_framebuffers, render_target) = create_framebuffer_objects(logical_device, allocator, render_pass, surface_format.format, depth_format, msaa_samples, swapchain_image_views, window_extent, new_framebuffer_queue);
+            retired_objects.push(frame_number, std::move(framebuffer_queue));
+            retired_objects.push(frame_number, std::move(render_pass_queue));
+            framebuffer_queue = std::move(new_framebuffer_queue);
+            render_pass_queue = std::move(new_render_pass_queue);
+        }
 
-                std::tie(graphics_pipelines, window_extent, swapchain, surface_format, swapchain_images, swapchain_image_views, swapchain_framebuffers, color_image, color_image_memory, color_image_view, depth_image, depth_image_view, depth_image_memory) = recreate_graphics_pipeline_and_swapchain(window, logical_device, physical_device, shader_cache, pipeline_layout, render_pass, surface, queue_family_index, surface_format.format, swapchain_queue);
-                cone_pipeline = graphics_pipelines[0];
-                grid_pipeline = graphics_pipelines[1];
-                aquarium_pipeline = graphics_pipelines[2];
-                debug_cube_pipeilne = graphics_pipelines[3];
+        {
+            const auto zone = profiling::scoped_zone("Acquire");
+            const auto result = vkAcquireNextImageKHR(logical_device, swapchain, UINT64_MAX, image_available_semaphore, VK_NULL_HANDLE, &image_index);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                // nothing was acquired or signaled, try again with a new swapchain
+                swapchain_outdated = true;
                 continue;
             }
-            else if (result != VK_SUCCESS)
+            else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
             {
                 throw std::runtime_error("");
             }
+            // a suboptimal image still presents fine, the swapchain is replaced next frame
+            swapchain_outdated = result == VK_SUBOPTIMAL_KHR;
         }
 
         VK_CHECK(vkResetFences(logical_device, 1, &fence));
@@ -353,6 +617,17 @@ int main()
 
         VK_CHECK(vkResetCommandBuffer(command_buffer, 0));
         VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+        gpu_profiler.begin_frame(command_buffer, current_frame);
+        const auto frame_gpu_zone = gpu_profiler.begin_zone(command_buffer, "Frame");
+
+        if (const auto frame_time = gpu_profiler.find("Frame"); frame_time && frame_time->samples != frame_time_samples)
+        {
+            frame_time_samples = frame_time->samples;
+            resolution_controller.update(resolution_settings, frame_time->latest());
+        }
+        // projection and lod selection stay at window size, only the pixels get coarser
+        const auto render_extent = resolution_controller.extent(window_extent);
+        gui_data.render_extent = render_extent;
 
         const auto clear_values = std::array{
             VkClearValue{
@@ -372,104 +647,303 @@ int main()
         // update camera
         camera_data.position = glm::vec4(g_camera.position(), 0.f);
         camera_data.viewproj = flip_clip_space * g_camera.projection(window_extent.width, window_extent.height) * g_camera.view();
+        camera_data.clusters = clustering::make_fragment_lookup(g_camera.view(), render_extent, g_camera.z_near(), g_camera.z_far());
         std::memcpy(reinterpret_cast<char*>(camera_data_memory_ptr) + current_frame * camera_data_padded_size, &camera_data, sizeof(camera_data));
 
         // update boids
-        model_data_update_buffer = std::vector(model_data_span.begin(), model_data_span.end());
-        for (std::size_t i = 0; i < instances_count; ++i)
+        const auto now = std::chrono::steady_clock::now();
+        const auto elapsed = std::chrono::duration<double>(now - last_frame_time).count();
+        last_frame_time = now;
+
+        const boids::snapshot* snapshot = nullptr;
         {
-            auto& model = model_data[i];
-            auto velocity_update = boids::steer(i, model_data_update_buffer, visual_range, cohesion_weight, separation_weight, alignment_weight);
-            for (const auto& repellent : aquarium::wall_repellents)
+            const auto zone = profiling::scoped_zone("Boids update");
+            if (simulation)
             {
-                velocity_update += glm::vec4(repellent.get_velocity_diff(model), 0);
+                // a full queue keeps the change around for the next frame
+                const auto parameters = boids::messages::set_parameters{
+                    .params = boids::parameters{
+                        .visual_range = visual_range,
+                        .cohesion_weight = cohesion_weight,
+                        .separation_weight = separation_weight,
+                        .alignment_weight = alignment_weight,
+                        .speed = model_speed
+                    },
+                    .wall_force_weight = wall_force_weight
+                };
+                if (parameters != posted_parameters && simulation->post(parameters))
+                {
+                    posted_parameters = parameters;
+                }
+                if (tick_rate != posted_tick_rate && simulation->post(boids::messages::set_tick_rate{ .tick_rate = tick_rate }))
+                {
+                    posted_tick_rate = tick_rate;
+                }
+                if (instances_count != posted_instances_count && simulation->post(boids::messages::set_count{ .count = instances_count }))
+                {
+                    posted_instances_count = instances_count;
+                }
+
+                snapshot = &simulation->latest();
             }
-            model.velocity = model.direction;
-            model.velocity += velocity_update;
-            model.velocity *= model_speed;
-            if (glm::length(model.velocity))
-                model.direction = glm::normalize(model.velocity);
-            const auto& [collision, normal] = aquarium::check_collision(model.position + model.velocity, aquarium::min_range, aquarium::max_range);
-            if (collision)
+            else if (flock.size() != instances_count)
             {
-                model.direction = glm::vec4(glm::reflect(glm::vec3(model.direction), normal), 0.);
+                const auto previous_count = flock.size();
+                flock.resize(instances_count);
+                boids::spawn(flock, aquarium::min_range, aquarium::max_range, previous_count);
             }
-            else
+        }
+
+        const auto& drawn_flock = snapshot ? snapshot->current : flock;
+        gui_data.cones = &drawn_flock;
+
+        gpu_instances_count = std::min(gpu_instances_count, flock.size());
+        gpu_uploaded_count = std::min(gpu_uploaded_count, flock.size());
+        instance_buffers.reserve(std::max<std::size_t>(drawn_flock.size(), 1), command_buffer, gpu_state, gpu_uploaded_count, frame_number, retired_objects);
+        culler.reserve(std::max<std::size_t>(drawn_flock.size(), 1), frame_number, retired_objects);
+
+        auto model_data_buffer_info = instance_buffers.frame_buffer_info(current_frame);
+        auto previous_model_data_buffer_info = model_data_buffer_info;
+        auto interpolation = 1.f;
+        if (gpu_simulation)
+        {
+            const auto zone = profiling::scoped_zone("Record simulation");
+            const auto simulation_zone = profiling::scoped_gpu_zone(gpu_profiler, command_buffer, "Simulation");
+            simulation_clock.set_tick_rate(tick_rate);
+            const auto ticks = simulation_clock.advance(elapsed);
+
+            // once per spawned range, frames without a tick would upload it again otherwise
+            if (gpu_uploaded_count < flock.size())
             {
-                model.position += model.velocity;
+                // this frame's host visible slice doubles as staging
+                boids::pack(flock, model_scale * 0.5f, instance_buffers.frame_data(current_frame, flock.size()), gpu_uploaded_count);
+                instance_buffers.upload_state(command_buffer, current_frame, gpu_uploaded_count, flock.size());
+                gpu_uploaded_count = flock.size();
             }
 
-            model.model_matrix = glm::translate(glm::mat4(1.), glm::vec3(model.position));
-            model.model_matrix = model.model_matrix * glm::mat4(glm::rotation({0, 1, 0}, glm::normalize(glm::vec3(model.direction))));
-            model.model_matrix = glm::scale(model.model_matrix, model_scale * glm::vec3(0.5));
+            const auto& state_buffers = instance_buffers.state_buffers();
+            const auto& velocity_buffers = instance_buffers.velocity_buffers();
+            for (auto tick = uint32_t{ 0 }; tick < ticks; ++tick)
+            {
+                const auto descriptor_set = compute_descriptor_sets[2 * current_frame + gpu_state];
+                // Each direction's set is updated the first time it's used this frame, buffers may have been replaced since this frame slot last ran.
+                // Updating it again after it was bound would invalidate the command buffer.
+                if (tick < 2)
+                {
+                    boids::compute::update_descriptor_set(logical_device, descriptor_set, state_buffers[gpu_state], state_buffers[1 - gpu_state], velocity_buffers[gpu_state], velocity_buffers[1 - gpu_state]);
+                }
+
+                const auto compute_params = boids::compute::push_constants{
+                    .min_range = glm::vec4(aquarium::min_range, 0.f),
+                    .max_range = glm::vec4(aquarium::max_range, 0.f),
+                    .count = static_cast<uint32_t>(flock.size()),
+                    .spawned_first = static_cast<uint32_t>(gpu_instances_count),
+                    .visual_range = visual_range,
+                    .cohesion_weight = cohesion_weight,
+                    .separation_weight = separation_weight,
+                    .alignment_weight = alignment_weight,
+                    .wall_force_weight = wall_force_weight,
+                    .speed = model_speed,
+                    .model_scale = model_scale * 0.5f
+                };
+                boids::compute::record_step(command_buffer, compute_pipeline, compute_pipeline_layout, descriptor_set, compute_params);
+
+                gpu_state = 1 - gpu_state;
+                gpu_instances_count = flock.size();
+            }
+
+            model_data_buffer_info = VkDescriptorBufferInfo{
+                .buffer = state_buffers[gpu_state],
+                .offset = 0,
+                .range = VK_WHOLE_SIZE
+            };
+            previous_model_data_buffer_info = VkDescriptorBufferInfo{
+                .buffer = state_buffers[1 - gpu_state],
+                .offset = 0,
+                .range = VK_WHOLE_SIZE
+            };
+            interpolation = simulation_clock.interpolation();
+        }
+        else
+        {
+            const auto zone = profiling::scoped_zone("Pack instances");
+            boids::pack(snapshot->current, snapshot->previous, snapshot->interpolation(now), model_scale * 0.5f, instance_buffers.frame_data(current_frame, drawn_flock.size()));
+            uploader.copy(instance_buffers.frame_buffer(), current_frame, drawn_flock.size() * sizeof(boids::instance));
         }
-        std::memcpy(reinterpret_cast<char*>(model_data_memory_ptr) + current_frame * model_data_padded_size, &model_data, sizeof(model_data));
 
         // update lights
-        std::memcpy(reinterpret_cast<char*>(dir_lights_data_memory_ptr) + current_frame * dir_lights_data_padded_size, lights.dir_lights.data(), lights.dir_lights.size() * sizeof(decltype(lights.dir_lights)::value_type));
-        std::memcpy(reinterpret_cast<char*>(point_lights_data_memory_ptr) + current_frame * point_lights_data_padded_size, lights.point_lights.data(), lights.point_lights.size() * sizeof(decltype(lights.point_lights)::value_type));
+        {
+            const auto zone = profiling::scoped_zone("Copy lights");
+            std::memcpy(dir_lights_data.data(current_frame), lights.dir_lights.data(), dir_lights_data_size);
+            uploader.copy(dir_lights_data, current_frame, dir_lights_data_size);
+            const auto point_lights_data_size = lights.point_lights.size() * sizeof(decltype(lights.point_lights)::value_type);
+            std::memcpy(point_lights_data.data(current_frame), lights.point_lights.data(), point_lights_data_size);
+            uploader.copy(point_lights_data, current_frame, point_lights_data_size);
+        }
 
+        auto uploaded_semaphore = VkSemaphore{ VK_NULL_HANDLE };
+        {
+            const auto zone = profiling::scoped_zone("Flush uploads");
+            uploaded_semaphore = uploader.flush(current_frame, command_buffer);
+        }
+
+        {
+            const auto zone = profiling::scoped_zone("Record culling");
+            const auto gpu_zone = profiling::scoped_gpu_zone(gpu_profiler, command_buffer, "Culling");
+            const auto cull_params = culling::push_constants{
+                .planes = culling::frustum_planes(camera_data.viewproj),
+                .count = static_cast<uint32_t>(drawn_flock.size()),
+                .interpolation = interpolation,
+                .mesh_radius = cone_radius,
+                // pixels per world unit at distance 1
+                .projection_scale = std::abs(g_camera.projection(window_extent.width, window_extent.height)[1][1]) * 0.5f * window_extent.height,
+                .lod_thresholds = lod_thresholds
+            };
+            culler.record(command_buffer, current_frame, model_data_buffer_info, previous_model_data_buffer_info, cull_params);
+        }
+
+        {
+            const auto zone = profiling::scoped_zone("Record light clusters");
+            const auto gpu_zone = profiling::scoped_gpu_zone(gpu_profiler, command_buffer, "Light clusters");
+            const auto cluster_params = clustering::make_push_constants(g_camera.view(), g_camera.projection(window_extent.width, window_extent.height), g_camera.z_near(), g_camera.z_far(), static_cast<uint32_t>(lights.point_lights.size()));
+            light_clusters.record(command_buffer, current_frame, point_lights_data.buffer_info(current_frame), cluster_params);
+        }
+
+        // one per binding in binding order, the update template reads binding n at n * sizeof(VkDescriptorBufferInfo)
         const auto buffer_infos = std::array{
             camera_data_descriptor_buffer_infos[current_frame],
-            model_data_descriptor_buffer_infos[current_frame],
-            dir_lights_data_descriptor_buffer_infos[current_frame],
-            point_lights_data_descriptor_buffer_infos[current_frame]
-        };
-        vkUpdateDescriptorSetWithTemplate(logical_device, descriptor_sets[current_frame], descriptor_update_template, buffer_infos.data());
-
-        const auto render_pass_begin_info = VkRenderPassBeginInfo{
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .pNext = nullptr,
-            .renderPass = render_pass,
-            .framebuffer = swapchain_framebuffers[image_index],
-            .renderArea = VkRect2D {
-                .offset = VkOffset2D { 0, 0 },
-                .extent = window_extent
-            },
-            .clearValueCount = clear_values.size(),
-            .pClearValues = clear_values.data()
+            model_data_buffer_info,
+            dir_lights_data.buffer_info(current_frame),
+            point_lights_data.buffer_info(current_frame),
+            previous_model_data_buffer_info,
+            culler.visible_buffer_info(current_frame),
+            light_clusters.buffer_info(current_frame)
         };
+        {
+            const auto zone = profiling::scoped_zone("Update descriptors");
+            vkUpdateDescriptorSetWithTemplate(logical_device, descriptor_sets[current_frame], descriptor_update_template, buffer_infos.data());
+        }
 
-        vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        {
+            const auto zone = profiling::scoped_zone("Record render pass");
+            const auto render_pass_begin_info = VkRenderPassBeginInfo{
+                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                .pNext = nullptr,
+                .renderPass = render_pass,
+                .framebuffer = scene_framebuffers[image_index],
+                .renderArea = VkRect2D {
+                    .offset = VkOffset2D { 0, 0 },
+                    .extent = render_extent
+                },
+                .clearValueCount = clear_values.size(),
+                .pClearValues = clear_values.data()
+            };
+
+            vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+            const auto viewport = VkViewport{
+                .x = 0.f,
+                .y = 0.f,
+                .width = static_cast<float>(render_extent.width),
+                .height = static_cast<float>(render_extent.height),
+                .minDepth = 0.f,
+                .maxDepth = 1.f
+            };
+            const auto scissor = VkRect2D{
+                .offset = VkOffset2D{ 0, 0 },
+                .extent = render_extent
+            };
+            vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+            vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+            vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(float), &aquarium::scale);
+            vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(float), sizeof(float), &interpolation);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_sets[current_frame], 0, nullptr);
+            {
+                const auto gpu_zone = profiling::scoped_gpu_zone(gpu_profiler, command_buffer, "Cones");
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, cone_pipelines->get(cone_variant));
+                const auto offsets = std::array{ VkDeviceSize{ 0 } };
+                vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets.data());
+                vkCmdBindIndexBuffer(command_buffer, vertex_buffer, cone_vertex_buffer_size, cone::index_type);
+                // one draw per lod bucket, a single multi draw would need the multiDrawIndirect feature
+                for (std::size_t lod = 0; lod < culling::lod_count; ++lod)
+                {
+                    vkCmdDrawIndexedIndirect(command_buffer, culler.draw_buffer(current_frame), lod * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+                }
+            }
 
-        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(float), &aquarium::scale);
-        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_sets[current_frame], 0, nullptr);
-        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, cone_pipeline);
-        const auto offsets = std::array{ VkDeviceSize{ 0 } };
-        vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets.data());
-        vkCmdDraw(command_buffer, cone_vertex_buffer.size(), instances_count, 0, 0);
+            {
+                const auto gpu_zone = profiling::scoped_gpu_zone(gpu_profiler, command_buffer, "Debug cubes");
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, debug_cube_pipeilne);
+                vkCmdDraw(command_buffer, 36, lights.point_lights.size(), 0, 0);
+            }
 
-        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, debug_cube_pipeilne);
-        vkCmdDraw(command_buffer, 36, lights.point_lights.size(), 0, 0);
+            {
+                const auto gpu_zone = profiling::scoped_gpu_zone(gpu_profiler, command_buffer, "Aquarium");
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, aquarium_pipeline);
+                vkCmdDraw(command_buffer, 36, 1, 0, 0);
+            }
 
-        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, aquarium_pipeline);
-        vkCmdDraw(command_buffer, 36, 1, 0, 0);
+            {
+                const auto gpu_zone = profiling::scoped_gpu_zone(gpu_profiler, command_buffer, "Grid");
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, grid_pipelines->get(grid::variant_index(grid_variant)));
+                vkCmdDraw(command_buffer, 6, 1, 0, 0);
+            }
 
-        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, grid_pipeline);
-        vkCmdDraw(command_buffer, 6, 1, 0, 0);
+            vkCmdEndRenderPass(command_buffer);
+        }
+        gpu_profiler.end_zone(command_buffer, frame_gpu_zone);
 
-        gui::draw(command_buffer, gui_data);
+        {
+            const auto gpu_zone = profiling::scoped_gpu_zone(gpu_profiler, command_buffer, "Upscale");
+            resolution::record_upscale(command_buffer, render_target, render_extent, swapchain_images[image_index], window_extent);
+        }
 
-        vkCmdEndRenderPass(command_buffer);
+        {
+            const auto zone = profiling::scoped_zone("Record gui pass");
+            const auto gui_pass_begin_info = VkRenderPassBeginInfo{
+                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                .pNext = nullptr,
+                .renderPass = gui_render_pass,
+                .framebuffer = gui_framebuffers[image_index],
+                .renderArea = VkRect2D {
+                    .offset = VkOffset2D { 0, 0 },
+                    .extent = window_extent
+                },
+                .clearValueCount = 0,
+                .pClearValues = nullptr
+            };
+
+            vkCmdBeginRenderPass(command_buffer, &gui_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+            {
+                const auto gpu_zone = profiling::scoped_gpu_zone(gpu_profiler, command_buffer, "ImGui");
+                gui::draw(command_buffer, gui_data);
+            }
+            vkCmdEndRenderPass(command_buffer);
+        }
         VK_CHECK(vkEndCommandBuffer(command_buffer));
 
-        const auto wait_semaphores = std::array{image_available_semaphore};
-        const auto wait_stages = VkPipelineStageFlags{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        const auto wait_semaphores = std::array{image_available_semaphore, uploaded_semaphore};
+        // the swapchain image is first touched by the upscale
+        const auto wait_stages = std::array{VkPipelineStageFlags{VK_PIPELINE_STAGE_TRANSFER_BIT}, VkPipelineStageFlags{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT}};
         const auto signal_semaphores = std::array{rendering_finished_semaphore};
 
         const auto submit_info = VkSubmitInfo{
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
             .pNext = nullptr,
-            .waitSemaphoreCount = 1,
+            .waitSemaphoreCount = uploaded_semaphore != VK_NULL_HANDLE ? 2u : 1u,
             .pWaitSemaphores = wait_semaphores.data(),
-            .pWaitDstStageMask = &wait_stages,
+            .pWaitDstStageMask = wait_stages.data(),
             .commandBufferCount = 1,
             .pCommandBuffers = &command_buffer,
             .signalSemaphoreCount = 1,
             .pSignalSemaphores = signal_semaphores.data(),
         };
 
-        VK_CHECK(vkQueueSubmit(present_queue, 1, &submit_info, fence));
+        {
+            const auto zone = profiling::scoped_zone("Submit");
+            VK_CHECK(vkQueueSubmit(present_queue, 1, &submit_info, fence));
+        }
 
         const auto present_info = VkPresentInfoKHR{
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -482,15 +956,30 @@ int main()
             .pResults = nullptr,
         };
 
-        VK_CHECK(vkQueuePresentKHR(present_queue, &present_info));
+        auto present_result = VkResult{};
+        {
+            const auto zone = profiling::scoped_zone("Present");
+            present_result = vkQueuePresentKHR(present_queue, &present_info);
+        }
+        if (present_result == VK_SUBOPTIMAL_KHR || present_result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            swapchain_outdated = true;
+        }
+        else
+        {
+            VK_CHECK(present_result);
+        }
 
         current_frame = (current_frame + 1) % overlapping_frames_count;
+        frame_number++;
     }
 
     VK_CHECK(vkDeviceWaitIdle(logical_device));
 
     spdlog::trace("Cleanup.");
 
+    cleanup::flush(framebuffer_queue);
     cleanup::flush(swapchain_queue);
+    cleanup::flush(render_pass_queue);
     cleanup::flush(general_queue);
 }
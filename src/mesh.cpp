@@ -0,0 +1,245 @@
+#include "mesh.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
+namespace mesh
+{
+    namespace
+    {
+        // a bit more than most gpus keep around, the scores fall off smoothly so overestimating barely hurts
+        constexpr auto cache_size = std::size_t{ 32 };
+        constexpr auto cache_decay_power = 1.5f;
+        constexpr auto last_triangle_score = 0.75f;
+        constexpr auto valence_boost_scale = 2.f;
+        constexpr auto valence_boost_power = 0.5f;
+
+        constexpr auto not_cached = -1;
+
+        // vertices used by few remaining triangles get a boost, so lone triangles aren't left behind for later cache misses
+        float vertex_score(int cache_position, uint32_t remaining_triangles)
+        {
+            if (remaining_triangles == 0)
+            {
+                return -1.f;
+            }
+
+            auto score = 0.f;
+            if (cache_position != not_cached && cache_position < 3)
+            {
+                // the last triangle's vertices, using them again right away isn't worth as much as it seems
+                score = last_triangle_score;
+            }
+            else if (cache_position != not_cached)
+            {
+                const auto scaler = 1.f / (cache_size - 3);
+                score = std::pow(1.f - (cache_position - 3) * scaler, cache_decay_power);
+            }
+            return score + valence_boost_scale * std::pow(static_cast<float>(remaining_triangles), -valence_boost_power);
+        }
+
+        struct vertex_hash
+        {
+            std::size_t operator()(const vertex& vertex) const
+            {
+                auto hash = std::size_t{ 0 };
+                for (const auto value : { vertex.pos.x, vertex.pos.y, vertex.pos.z, vertex.normal.x, vertex.normal.y, vertex.normal.z })
+                {
+                    hash ^= std::hash<float>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+                }
+                return hash;
+            }
+        };
+
+        struct vertex_equal
+        {
+            bool operator()(const vertex& lhs, const vertex& rhs) const
+            {
+                return lhs.pos == rhs.pos && lhs.normal == rhs.normal;
+            }
+        };
+    }
+
+    indexed deduplicate(std::span<const vertex> triangles)
+    {
+        assert(triangles.size() % 3 == 0);
+
+        auto mesh = indexed{};
+        auto lookup = std::unordered_map<vertex, uint16_t, vertex_hash, vertex_equal>{};
+        mesh.indices.reserve(triangles.size());
+        for (const auto& vertex : triangles)
+        {
+            const auto [it, inserted] = lookup.try_emplace(vertex, static_cast<uint16_t>(mesh.vertices.size()));
+            if (inserted)
+            {
+                assert(mesh.vertices.size() <= std::numeric_limits<uint16_t>::max());
+                mesh.vertices.push_back(vertex);
+            }
+            mesh.indices.push_back(it->second);
+        }
+        return mesh;
+    }
+
+    void optimize_vertex_cache(std::span<uint16_t> indices, std::size_t vertices_count)
+    {
+        assert(indices.size() % 3 == 0);
+        const auto triangles_count = indices.size() / 3;
+
+        // triangles around each vertex, the first remaining[v] of them aren't emitted yet
+        auto remaining = std::vector<uint32_t>(vertices_count, 0);
+        for (const auto index : indices)
+        {
+            ++remaining[index];
+        }
+        auto adjacency_offsets = std::vector<uint32_t>(vertices_count + 1, 0);
+        for (std::size_t v = 0; v < vertices_count; ++v)
+        {
+            adjacency_offsets[v + 1] = adjacency_offsets[v] + remaining[v];
+        }
+        auto adjacency = std::vector<uint32_t>(indices.size());
+        {
+            auto filled = std::vector<uint32_t>(vertices_count, 0);
+            for (std::size_t i = 0; i < indices.size(); ++i)
+            {
+                const auto v = indices[i];
+                adjacency[adjacency_offsets[v] + filled[v]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        auto cache_positions = std::vector<int>(vertices_count, not_cached);
+        auto vertex_scores = std::vector<float>(vertices_count);
+        for (std::size_t v = 0; v < vertices_count; ++v)
+        {
+            vertex_scores[v] = vertex_score(not_cached, remaining[v]);
+        }
+
+        const auto triangle_score = [&](std::size_t triangle) {
+            return vertex_scores[indices[3 * triangle]] + vertex_scores[indices[3 * triangle + 1]] + vertex_scores[indices[3 * triangle + 2]];
+        };
+        auto triangle_scores = std::vector<float>(triangles_count);
+        for (std::size_t t = 0; t < triangles_count; ++t)
+        {
+            triangle_scores[t] = triangle_score(t);
+        }
+
+        auto emitted = std::vector<bool>(triangles_count, false);
+        auto output = std::vector<uint16_t>{};
+        output.reserve(indices.size());
+        auto cache = std::vector<uint16_t>{};
+        cache.reserve(cache_size + 3);
+
+        for (std::size_t step = 0; step < triangles_count; ++step)
+        {
+            // best triangle around the cached vertices, every remaining one after a miss
+            auto best = std::numeric_limits<std::size_t>::max();
+            auto best_score = -1.f;
+            for (const auto v : cache)
+            {
+                for (auto i = adjacency_offsets[v]; i < adjacency_offsets[v] + remaining[v]; ++i)
+                {
+                    if (triangle_scores[adjacency[i]] > best_score)
+                    {
+                        best = adjacency[i];
+                        best_score = triangle_scores[best];
+                    }
+                }
+            }
+            if (best == std::numeric_limits<std::size_t>::max())
+            {
+                for (std::size_t t = 0; t < triangles_count; ++t)
+                {
+                    if (!emitted[t] && triangle_scores[t] > best_score)
+                    {
+                        best = t;
+                        best_score = triangle_scores[t];
+                    }
+                }
+            }
+
+            emitted[best] = true;
+            for (std::size_t corner = 0; corner < 3; ++corner)
+            {
+                const auto v = indices[3 * best + corner];
+                output.push_back(v);
+
+                // swap the triangle out of the vertex's remaining range
+                const auto first = adjacency.begin() + adjacency_offsets[v];
+                const auto last = first + remaining[v];
+                std::iter_swap(std::find(first, last, static_cast<uint32_t>(best)), last - 1);
+                --remaining[v];
+
+                // most recent at the front
+                if (const auto cached = std::find(cache.begin(), cache.end(), v); cached != cache.end())
+                {
+                    cache.erase(cached);
+                }
+                cache.insert(cache.begin(), v);
+            }
+
+            for (std::size_t i = 0; i < cache.size(); ++i)
+            {
+                const auto v = cache[i];
+                cache_positions[v] = i < cache_size ? static_cast<int>(i) : not_cached;
+                vertex_scores[v] = vertex_score(cache_positions[v], remaining[v]);
+            }
+            for (const auto v : cache)
+            {
+                for (auto i = adjacency_offsets[v]; i < adjacency_offsets[v] + remaining[v]; ++i)
+                {
+                    triangle_scores[adjacency[i]] = triangle_score(adjacency[i]);
+                }
+            }
+            if (cache.size() > cache_size)
+            {
+                cache.resize(cache_size);
+            }
+        }
+
+        std::copy(output.begin(), output.end(), indices.begin());
+    }
+
+    void optimize_vertex_fetch(indexed& mesh)
+    {
+        constexpr auto unassigned = std::numeric_limits<uint16_t>::max();
+
+        auto remap = std::vector<uint16_t>(mesh.vertices.size(), unassigned);
+        auto vertices = std::vector<vertex>{};
+        vertices.reserve(mesh.vertices.size());
+        for (auto& index : mesh.indices)
+        {
+            if (remap[index] == unassigned)
+            {
+                remap[index] = static_cast<uint16_t>(vertices.size());
+                vertices.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        mesh.vertices = std::move(vertices);
+    }
+
+    glm::vec2 octahedral_encode(const glm::vec3& normal)
+    {
+        const auto n = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+        if (n.z >= 0.f)
+        {
+            return glm::vec2(n.x, n.y);
+        }
+        // fold the lower hemisphere over the diagonals
+        const auto sign = glm::vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+        return (1.f - glm::abs(glm::vec2(n.y, n.x))) * sign;
+    }
+
+    packed_vertex quantize(const vertex& vertex)
+    {
+        return packed_vertex{
+            .pos = glm::packHalf(glm::vec4(vertex.pos, 1.f)),
+            .normal = glm::packSnorm<int16_t>(octahedral_encode(vertex.normal))
+        };
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace mesh
+{
+    struct indexed
+    {
+        std::vector<vertex> vertices;
+        std::vector<uint16_t> indices;
+    };
+
+    // Merges the equal vertices of a triangle list. Flat shaded faces only share vertices within their plane.
+    indexed deduplicate(std::span<const vertex> triangles);
+
+    // Reorders triangles so consecutive ones reuse vertices still in the post-transform cache, Tom Forsyth's linear speed optimizer.
+    // Picking a triangle after a cache miss scans every remaining one, fine for the small meshes here.
+    void optimize_vertex_cache(std::span<uint16_t> indices, std::size_t vertices_count);
+
+    // Renumbers vertices by first use, so fetches walk the vertex buffer forwards. Run after optimize_vertex_cache.
+    void optimize_vertex_fetch(indexed& mesh);
+
+    // unit normal, both components in [-1, 1]
+    glm::vec2 octahedral_encode(const glm::vec3& normal);
+    packed_vertex quantize(const vertex& vertex);
+}
@@ -0,0 +1,127 @@
+#include "pipeline_cache.hpp"
+#include "vkcheck.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace pipelines
+{
+    namespace
+    {
+        std::vector<char> read_file(const std::filesystem::path& path)
+        {
+            auto file = std::ifstream(path, std::ios::binary);
+            if (!file.is_open())
+            {
+                return {};
+            }
+            return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        // the driver would reject foreign data too, but silently - this says why
+        bool is_compatible(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties)
+        {
+            auto header = VkPipelineCacheHeaderVersionOne{};
+            if (data.size() < sizeof(header))
+            {
+                spdlog::info("Pipeline cache is too short for a header.");
+                return false;
+            }
+            std::memcpy(&header, data.data(), sizeof(header));
+
+            if (header.headerSize < sizeof(header) || header.headerSize > data.size() || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+            {
+                spdlog::info("Pipeline cache header version {} is not supported.", static_cast<uint32_t>(header.headerVersion));
+                return false;
+            }
+            if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID)
+            {
+                spdlog::info("Pipeline cache was written for vendor {:#x} device {:#x}.", header.vendorID, header.deviceID);
+                return false;
+            }
+            if (std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+            {
+                spdlog::info("Pipeline cache was written by another driver version.");
+                return false;
+            }
+            return true;
+        }
+    }
+
+    disk_cache::disk_cache(VkDevice device, const VkPhysicalDeviceProperties& properties, std::filesystem::path path)
+        : _device(device), _properties(properties), _path(std::move(path))
+    {
+        assert(_device != VK_NULL_HANDLE);
+
+        auto data = read_file(_path);
+        if (!data.empty() && !is_compatible(data, _properties))
+        {
+            data.clear();
+        }
+        _warm = !data.empty();
+        spdlog::info("Pipeline cache {}: {}.", _path.string(), _warm ? fmt::format("loaded {} bytes", data.size()) : "starting cold");
+
+        const auto create_info = VkPipelineCacheCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .initialDataSize = data.size(),
+            .pInitialData = data.data()
+        };
+        VK_CHECK(vkCreatePipelineCache(_device, &create_info, nullptr, &_cache));
+    }
+
+    disk_cache::~disk_cache()
+    {
+        clear();
+    }
+
+    void disk_cache::report(std::string_view what, std::chrono::duration<double> elapsed)
+    {
+        spdlog::info("{} created in {:.2f} ms, {} pipeline cache.", what, elapsed.count() * 1000., _warm ? "warm" : "cold");
+        _warm = true;
+    }
+
+    void disk_cache::save() const
+    {
+        auto size = std::size_t{ 0 };
+        VK_CHECK(vkGetPipelineCacheData(_device, _cache, &size, nullptr));
+        auto data = std::vector<char>(size);
+        VK_CHECK(vkGetPipelineCacheData(_device, _cache, &size, data.data()));
+        data.resize(size);
+
+        auto temporary_path = _path;
+        temporary_path += ".tmp";
+        {
+            auto file = std::ofstream(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!file.write(data.data(), data.size()) || !file.flush())
+            {
+                spdlog::warn("Could not write pipeline cache to {}.", temporary_path.string());
+                return;
+            }
+        }
+
+        auto error = std::error_code{};
+        std::filesystem::rename(temporary_path, _path, error);
+        if (error)
+        {
+            spdlog::warn("Could not replace pipeline cache {}: {}", _path.string(), error.message());
+            std::filesystem::remove(temporary_path, error);
+            return;
+        }
+        spdlog::info("Pipeline cache saved, {} bytes.", data.size());
+    }
+
+    void disk_cache::clear()
+    {
+        if (_cache != VK_NULL_HANDLE)
+        {
+            vkDestroyPipelineCache(_device, _cache, nullptr);
+            _cache = VK_NULL_HANDLE;
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Volk/volk.h>
+
+#include <chrono>
+#include <filesystem>
+#include <string_view>
+
+namespace pipelines
+{
+    // VkPipelineCache shared by every pipeline, loaded from path on launch and written back by save().
+    // Data from another driver, device or cache version is dropped and the cache starts cold.
+    class disk_cache final
+    {
+    public:
+        disk_cache(VkDevice device, const VkPhysicalDeviceProperties& properties, std::filesystem::path path);
+        ~disk_cache();
+
+        disk_cache(const disk_cache&) = delete;
+        disk_cache(disk_cache&&) = delete;
+        disk_cache& operator=(const disk_cache&) = delete;
+        disk_cache& operator=(disk_cache&&) = delete;
+
+        VkPipelineCache handle() const { return _cache; }
+
+        // Logs how long creating `what` took. Cold until pipelines were loaded from disk or created once already.
+        void report(std::string_view what, std::chrono::duration<double> elapsed);
+
+        // writes a temporary file and renames it over path, a crash halfway never leaves a torn cache behind
+        void save() const;
+        void clear();
+
+    private:
+        VkDevice _device;
+        VkPhysicalDeviceProperties _properties;
+        std::filesystem::path _path;
+        VkPipelineCache _cache = VK_NULL_HANDLE;
+        bool _warm = false;
+    };
+}
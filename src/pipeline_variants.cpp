@@ -0,0 +1,15 @@
+#include "pipeline_variants.hpp"
+#include "setup.hpp"
+
+namespace pipelines
+{
+    variants::variants(VkDevice logical_device, VkPipelineCache pipeline_cache, uint32_t count, const create_info_builder& create_info, cleanup::queue_type& cleanup_queue)
+    {
+        auto create_infos = std::vector<VkGraphicsPipelineCreateInfo>(count);
+        for (uint32_t variant = 0; variant < count; ++variant)
+        {
+            create_infos[variant] = create_info(variant);
+        }
+        _pipelines = create_graphics_pipelines(logical_device, pipeline_cache, create_infos, cleanup_queue);
+    }
+}
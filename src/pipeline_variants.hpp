@@ -0,0 +1,68 @@
+#pragma once
+
+#include "cleanup.hpp"
+
+#include <Volk/volk.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace pipelines
+{
+    // Specialization constants 0..N-1 of a shader stage, every one 32 bits wide - uint or bool in glsl.
+    // info points into the object itself, so it can't move: keep it in a node based container for as long as create infos use it.
+    template<std::size_t N>
+    struct specialization
+    {
+        explicit specialization(const std::array<uint32_t, N>& constants)
+            : values(constants)
+        {
+            for (uint32_t i = 0; i < N; ++i)
+            {
+                entries[i] = VkSpecializationMapEntry{
+                    .constantID = i,
+                    .offset = i * static_cast<uint32_t>(sizeof(uint32_t)),
+                    .size = sizeof(uint32_t)
+                };
+            }
+            info = VkSpecializationInfo{
+                .mapEntryCount = static_cast<uint32_t>(N),
+                .pMapEntries = entries.data(),
+                .dataSize = sizeof(values),
+                .pData = values.data()
+            };
+        }
+
+        specialization(const specialization&) = delete;
+        specialization(specialization&&) = delete;
+        specialization& operator=(const specialization&) = delete;
+        specialization& operator=(specialization&&) = delete;
+
+        std::array<uint32_t, N> values;
+        std::array<VkSpecializationMapEntry, N> entries;
+        VkSpecializationInfo info;
+    };
+
+    // Every variant of one graphics pipeline, keyed by the variant's feature bits and built up front in one batch,
+    // so switching features at runtime binds another pipeline instead of compiling one or branching per fragment.
+    class variants final
+    {
+    public:
+        using create_info_builder = std::function<VkGraphicsPipelineCreateInfo(uint32_t variant)>;
+
+        // builds variants [0, count)
+        variants(VkDevice logical_device, VkPipelineCache pipeline_cache, uint32_t count, const create_info_builder& create_info, cleanup::queue_type& cleanup_queue);
+
+        variants(const variants&) = delete;
+        variants(variants&&) = delete;
+        variants& operator=(const variants&) = delete;
+        variants& operator=(variants&&) = delete;
+
+        VkPipeline get(uint32_t variant) const { return _pipelines[variant]; }
+
+    private:
+        std::vector<VkPipeline> _pipelines;
+    };
+}
@@ -1,12 +1,12 @@
 #include "setup.hpp"
 #include "vkcheck.hpp"
-#include "constants.hpp"
 
 #include <set>
 #include <string_view>
 #include <algorithm>
 #include <array>
 #include <fstream>
+#include <map>
 
 namespace window
 {
@@ -192,11 +192,11 @@ bool check_instance_layers(const std::vector<const char*>& requested_layers)
     return found;
 }
 
-std::optional<uint32_t> pick_family_index(VkQueueFlagBits bits, const std::vector<VkQueueFamilyProperties>& queue_props)
+std::optional<uint32_t> pick_family_index(VkQueueFlagBits bits, const std::vector<VkQueueFamilyProperties>& queue_props, VkQueueFlags excluded_bits)
 {
     for (int i = 0; const auto& prop : queue_props)
     {
-        const bool supports_requested_operations = prop.queueFlags & bits;
+        const bool supports_requested_operations = (prop.queueFlags & bits) && !(prop.queueFlags & excluded_bits);
 
         const bool supports_graphics = prop.queueFlags & VK_QUEUE_GRAPHICS_BIT;
         const bool supports_compute = prop.queueFlags & VK_QUEUE_COMPUTE_BIT;
@@ -220,6 +220,17 @@ std::optional<uint32_t> pick_family_index(VkQueueFlagBits bits, const std::vecto
     return std::nullopt;
 }
 
+std::vector<VkQueueFamilyProperties> get_queue_family_properties(VkPhysicalDevice physical_device)
+{
+    auto count = uint32_t{ 0 };
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
+    auto queue_family_props = std::vector<VkQueueFamilyProperties>(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, queue_family_props.data());
+    assert(queue_family_props.size() == count);
+
+    return queue_family_props;
+}
+
 bool check_device_extensions(VkPhysicalDevice device, const std::vector<const char*> required_device_extensions)
 {
     auto count = uint32_t{ 0 };
@@ -257,11 +268,16 @@ std::tuple<VkPhysicalDevice, uint32_t, VkPhysicalDeviceProperties> pick_physical
         vkGetPhysicalDeviceProperties(physical_device, &props);
         spdlog::info("Checking {}", props.deviceName);
 
-        auto count = uint32_t{ 0 };
-        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
-        auto queue_family_props = std::vector<VkQueueFamilyProperties>(count);
-        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, queue_family_props.data());
-        assert(queue_family_props.size() == count);
+        // cone lod buckets start at firstInstance, create_logical_device enables it
+        auto features = VkPhysicalDeviceFeatures{};
+        vkGetPhysicalDeviceFeatures(physical_device, &features);
+        if (!features.drawIndirectFirstInstance)
+        {
+            spdlog::info("Skipping {}, it doesn't support drawIndirectFirstInstance.", props.deviceName);
+            continue;
+        }
+
+        const auto queue_family_props = get_queue_family_properties(physical_device);
 
         // TODO this condition may be a bit too restrictive, but is sufficient for development now
         const auto suitable_queue_family_index = pick_family_index(required_bits, queue_family_props);
@@ -285,28 +301,72 @@ std::tuple<VkPhysicalDevice, uint32_t, VkPhysicalDeviceProperties> pick_physical
     throw std::runtime_error("No suitable physical device found. Revisit device suitability logic");
 }
 
-std::tuple<VkDevice, VkQueue> create_logical_device(VkPhysicalDevice physical_device, uint32_t queue_family_index, const std::vector<const char*>& device_extensions, cleanup::queue_type& cleanup_queue)
+std::vector<VkSampleCountFlagBits> get_supported_sample_counts(const VkPhysicalDeviceProperties& properties)
+{
+    // the scene renders to one color and one depth attachment, both have to take the count
+    const auto supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+    auto counts = std::vector<VkSampleCountFlagBits>{};
+    for (const auto count : { VK_SAMPLE_COUNT_1_BIT, VK_SAMPLE_COUNT_2_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_8_BIT })
+    {
+        if (supported & count)
+        {
+            counts.push_back(count);
+        }
+    }
+    return counts;
+}
+
+VkFormat choose_depth_format(VkPhysicalDevice physical_device)
+{
+    // no stencil is used, D16_UNORM is always there as a last resort
+    for (const auto format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM })
+    {
+        auto properties = VkFormatProperties{};
+        vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        {
+            return format;
+        }
+    }
+
+    throw std::runtime_error("No supported depth format.");
+}
+
+std::tuple<VkDevice, VkQueue, VkQueue> create_logical_device(VkPhysicalDevice physical_device, uint32_t queue_family_index, std::optional<uint32_t> transfer_queue_family_index, const std::vector<const char*>& device_extensions, cleanup::queue_type& cleanup_queue)
 {
     const auto queue_prio = 1.f;
-    const auto queue_create_info = VkDeviceQueueCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .queueFamilyIndex = queue_family_index,
-        .queueCount = 1, // one queue should be sufficient for now
-        .pQueuePriorities = &queue_prio
+    const auto queue_create_infos = std::array{
+        VkDeviceQueueCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .queueFamilyIndex = queue_family_index,
+            .queueCount = 1, // one queue should be sufficient for now
+            .pQueuePriorities = &queue_prio
+        },
+        VkDeviceQueueCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .queueFamilyIndex = transfer_queue_family_index.value_or(0),
+            .queueCount = 1,
+            .pQueuePriorities = &queue_prio
+        }
     };
 
     auto features = VkPhysicalDeviceFeatures{};
     features.fillModeNonSolid = VK_TRUE;
     features.wideLines = VK_TRUE;
+    // cone lod buckets start at firstInstance
+    features.drawIndirectFirstInstance = VK_TRUE;
 
     const auto create_info = VkDeviceCreateInfo{
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
-        .queueCreateInfoCount = 1,
-        .pQueueCreateInfos = &queue_create_info,
+        .queueCreateInfoCount = transfer_queue_family_index.has_value() ? 2u : 1u,
+        .pQueueCreateInfos = queue_create_infos.data(),
         .enabledLayerCount = 0, // deprecated + ignored
         .ppEnabledLayerNames = nullptr, // deprecated + ignored 
         .enabledExtensionCount = static_cast<uint32_t>(device_extensions.size()),
@@ -323,7 +383,14 @@ std::tuple<VkDevice, VkQueue> create_logical_device(VkPhysicalDevice physical_de
     vkGetDeviceQueue(device, queue_family_index, 0, &present_queue); // TODO: hardcoded queue index
     assert(present_queue);
 
-    return std::tuple{ device, present_queue };
+    auto transfer_queue = VkQueue{ VK_NULL_HANDLE };
+    if (transfer_queue_family_index)
+    {
+        vkGetDeviceQueue(device, *transfer_queue_family_index, 0, &transfer_queue);
+        assert(transfer_queue);
+    }
+
+    return std::tuple{ device, present_queue, transfer_queue };
 }
 
 VkExtent2D choose_extent(const VkSurfaceCapabilitiesKHR& surface_caps, VkExtent2D glfw_framebuffer_extent)
@@ -368,7 +435,7 @@ VkSurfaceFormatKHR choose_image_format(const std::vector<VkSurfaceFormatKHR>& av
     return available_formats[0]; // fallback
 }
 
-std::tuple<VkSwapchainKHR, VkSurfaceFormatKHR> create_swapchain(VkDevice logical_device, VkPhysicalDevice physical_device, VkSurfaceKHR surface, uint32_t queue_family_index, VkExtent2D glfw_framebuffer_extent, cleanup::queue_type& cleanup_queue)
+std::tuple<VkSwapchainKHR, VkSurfaceFormatKHR> create_swapchain(VkDevice logical_device, VkPhysicalDevice physical_device, VkSurfaceKHR surface, uint32_t queue_family_index, VkExtent2D glfw_framebuffer_extent, VkSwapchainKHR old_swapchain, cleanup::queue_type& cleanup_queue)
 {
     // TODO move these out of the function to not repeat the calls in main loop
     auto surface_caps = VkSurfaceCapabilitiesKHR{};
@@ -391,6 +458,19 @@ std::tuple<VkSwapchainKHR, VkSurfaceFormatKHR> create_swapchain(VkDevice logical
     const auto min_image_count = surface_caps.minImageCount; // TODO should I request more images here?
     const auto present_mode = choose_present_mode(present_modes);
 
+    // the upscale blits the render target, same format, into the swapchain image with linear filtering
+    if (!(surface_caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+    {
+        throw std::runtime_error("Swapchain images don't support VK_IMAGE_USAGE_TRANSFER_DST_BIT, the scene can't be blitted to them.");
+    }
+    auto format_properties = VkFormatProperties{};
+    vkGetPhysicalDeviceFormatProperties(physical_device, surface_format.format, &format_properties);
+    constexpr auto blit_features = VkFormatFeatureFlags{ VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT };
+    if ((format_properties.optimalTilingFeatures & blit_features) != blit_features)
+    {
+        throw std::runtime_error("Surface format doesn't support linear blits, the scene can't be upscaled to the swapchain image.");
+    }
+
     auto create_info = VkSwapchainCreateInfoKHR{
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .pNext = nullptr,
@@ -401,7 +481,8 @@ std::tuple<VkSwapchainKHR, VkSurfaceFormatKHR> create_swapchain(VkDevice logical
         .imageColorSpace = surface_format.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        // the scene is blitted in, the gui drawn over it
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
         .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 1,
         .pQueueFamilyIndices = &queue_family_index,
@@ -409,7 +490,7 @@ std::tuple<VkSwapchainKHR, VkSurfaceFormatKHR> create_swapchain(VkDevice logical
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
         .presentMode = present_mode,
         .clipped = VK_TRUE,
-        .oldSwapchain = VK_NULL_HANDLE,
+        .oldSwapchain = old_swapchain,
     };
 
     auto swapchain = VkSwapchainKHR{ 0 };
@@ -473,16 +554,20 @@ std::tuple<std::vector<VkImage>, std::vector<VkImageView>> get_swapchain_images(
 
 VkRenderPass create_render_pass(VkDevice logical_device, VkFormat swapchain_format, VkFormat depth_format, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue)
 {
+    const auto multisampled = samples != VK_SAMPLE_COUNT_1_BIT;
+
+    // without msaa this is the render target itself, left for the upscale
     const auto color_attachment = VkAttachmentDescription{
         .flags = 0,
         .format = swapchain_format,
         .samples = samples,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        // only the resolve attachment outlives the pass, tilers never write the samples out
+        .storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
     };
 
     const auto depth_attachment = VkAttachmentDescription{
@@ -490,8 +575,8 @@ VkRenderPass create_render_pass(VkDevice logical_device, VkFormat swapchain_form
         .format = depth_format,
         .samples = samples,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
@@ -506,7 +591,7 @@ VkRenderPass create_render_pass(VkDevice logical_device, VkFormat swapchain_form
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+        .finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
     };
 
     const auto color_attachment_reference = VkAttachmentReference{
@@ -531,17 +616,18 @@ VkRenderPass create_render_pass(VkDevice logical_device, VkFormat swapchain_form
         .pInputAttachments = nullptr,
         .colorAttachmentCount = 1,
         .pColorAttachments = &color_attachment_reference,
-        .pResolveAttachments = &color_resolve_reference,
+        .pResolveAttachments = multisampled ? &color_resolve_reference : nullptr,
         .pDepthStencilAttachment = &depth_attachment_reference,
         .preserveAttachmentCount = 0,
         .pPreserveAttachments = nullptr
     };
 
     const auto subpass_dependencies = std::array{
+        // the previous frame's upscale may still read the render target
         VkSubpassDependency{
             .srcSubpass = VK_SUBPASS_EXTERNAL,
             .dstSubpass = 0,
-            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
             .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
             .srcAccessMask = 0,
             .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
@@ -556,6 +642,15 @@ VkRenderPass create_render_pass(VkDevice logical_device, VkFormat swapchain_form
             .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
             .dependencyFlags = 0
         },
+        VkSubpassDependency{
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .dependencyFlags = 0
+        },
     };
 
     const auto attachments = std::array{ color_attachment, depth_attachment, color_resolve_attachment };
@@ -563,7 +658,7 @@ VkRenderPass create_render_pass(VkDevice logical_device, VkFormat swapchain_form
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
-        .attachmentCount = attachments.size(),
+        .attachmentCount = multisampled ? 3u : 2u,
         .pAttachments = attachments.data(),
         .subpassCount = 1,
         .pSubpasses = &subpass,
@@ -579,12 +674,94 @@ VkRenderPass create_render_pass(VkDevice logical_device, VkFormat swapchain_form
     return render_pass;
 }
 
+VkRenderPass create_gui_render_pass(VkDevice logical_device, VkFormat swapchain_format, cleanup::queue_type& cleanup_queue)
+{
+    // draws over the upscaled scene
+    const auto color_attachment = VkAttachmentDescription{
+        .flags = 0,
+        .format = swapchain_format,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+    };
+
+    const auto color_attachment_reference = VkAttachmentReference{
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+
+    const auto subpass = VkSubpassDescription{
+        .flags = 0,
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount = 0,
+        .pInputAttachments = nullptr,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_attachment_reference,
+        .pResolveAttachments = nullptr,
+        .pDepthStencilAttachment = nullptr,
+        .preserveAttachmentCount = 0,
+        .pPreserveAttachments = nullptr
+    };
+
+    const auto subpass_dependency = VkSubpassDependency{
+        .srcSubpass = VK_SUBPASS_EXTERNAL,
+        .dstSubpass = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dependencyFlags = 0
+    };
+
+    const auto render_pass_create_info = VkRenderPassCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .attachmentCount = 1,
+        .pAttachments = &color_attachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 1,
+        .pDependencies = &subpass_dependency
+    };
+
+    auto render_pass = VkRenderPass{};
+    VK_CHECK(vkCreateRenderPass(logical_device, &render_pass_create_info, nullptr, &render_pass));
+
+    cleanup_queue.push([logical_device, render_pass]() { vkDestroyRenderPass(logical_device, render_pass, nullptr); });
+
+    return render_pass;
+}
+
+const VkPipelineMultisampleStateCreateInfo& get_multisample_state(VkSampleCountFlagBits samples)
+{
+    // one per sample count, pipeline create infos point into them
+    static auto multisample_states = std::map<VkSampleCountFlagBits, VkPipelineMultisampleStateCreateInfo>{};
+
+    return multisample_states.try_emplace(samples, VkPipelineMultisampleStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .rasterizationSamples = samples,
+        .sampleShadingEnable = VK_FALSE,
+        .minSampleShading = 1.f,
+        .pSampleMask = nullptr,
+        .alphaToCoverageEnable = VK_FALSE,
+        .alphaToOneEnable = VK_FALSE
+    }).first->second;
+}
+
 VkPipelineLayout create_pipeline_layout(VkDevice logical_device, const std::vector<VkDescriptorSetLayout>& set_layouts, cleanup::queue_type& cleanup_queue)
 {
+    // aquarium scale, boids interpolation
     const auto push_constant_range = VkPushConstantRange{
         .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         .offset = 0,
-        .size = sizeof(float)
+        .size = 2 * sizeof(float)
     };
 
     const auto pipeline_layout_create_info = VkPipelineLayoutCreateInfo{
@@ -605,10 +782,10 @@ VkPipelineLayout create_pipeline_layout(VkDevice logical_device, const std::vect
     return pipeline_layout;
 }
 
-std::vector<VkPipeline> create_graphics_pipelines(VkDevice logical_device, const std::vector<VkGraphicsPipelineCreateInfo>& create_infos, cleanup::queue_type& cleanup_queue)
+std::vector<VkPipeline> create_graphics_pipelines(VkDevice logical_device, VkPipelineCache pipeline_cache, const std::vector<VkGraphicsPipelineCreateInfo>& create_infos, cleanup::queue_type& cleanup_queue)
 {
     auto pipelines = std::vector<VkPipeline>(create_infos.size());
-    vkCreateGraphicsPipelines(logical_device, VK_NULL_HANDLE, create_infos.size(), create_infos.data(), nullptr, pipelines.data());
+    vkCreateGraphicsPipelines(logical_device, pipeline_cache, create_infos.size(), create_infos.data(), nullptr, pipelines.data());
 
     cleanup_queue.push([logical_device, pipelines]() {
         for (const auto pipeline : pipelines)
@@ -619,22 +796,49 @@ std::vector<VkPipeline> create_graphics_pipelines(VkDevice logical_device, const
     return pipelines;
 }
 
-std::vector<VkFramebuffer> create_swapchain_framebuffers(VkDevice logical_device, VkRenderPass render_pass, const std::vector<VkImageView>& color_imageviews, const std::vector<VkImageView>& swapchain_imageviews, const std::vector<VkImageView> depth_image_views, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue)
+std::vector<VkFramebuffer> create_scene_framebuffers(VkDevice logical_device, VkRenderPass render_pass, const std::vector<VkImageView>& color_imageviews, const std::vector<VkImageView>& target_imageviews, const std::vector<VkImageView> depth_image_views, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue)
 {
-    assert(swapchain_imageviews.size() == depth_image_views.size());
+    assert(target_imageviews.size() == depth_image_views.size());
 
+    auto framebuffers = std::vector<VkFramebuffer>(target_imageviews.size());
+
+    for (std::size_t i = 0; i < target_imageviews.size(); ++i)
+    {
+        // without multisampling the render target is the color attachment and nothing is resolved
+        const auto attachments = color_imageviews.empty() ? std::vector{ target_imageviews[i], depth_image_views[i] } : std::vector{ color_imageviews[i], depth_image_views[i], target_imageviews[i] };
+        const auto create_info = VkFramebufferCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .renderPass = render_pass,
+            .attachmentCount = static_cast<uint32_t>(attachments.size()),
+            .pAttachments = attachments.data(),
+            .width = swapchain_extent.width,
+            .height = swapchain_extent.height,
+            .layers = 1
+        };
+
+        VK_CHECK(vkCreateFramebuffer(logical_device, &create_info, nullptr, &framebuffers[i]));
+
+        cleanup_queue.push([logical_device, framebuffer = framebuffers[i]]() { vkDestroyFramebuffer(logical_device, framebuffer, nullptr); });
+    }
+
+    return framebuffers;
+}
+
+std::vector<VkFramebuffer> create_gui_framebuffers(VkDevice logical_device, VkRenderPass render_pass, const std::vector<VkImageView>& swapchain_imageviews, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue)
+{
     auto framebuffers = std::vector<VkFramebuffer>(swapchain_imageviews.size());
 
     for (std::size_t i = 0; i < swapchain_imageviews.size(); ++i)
     {
-        const auto attachments = std::array{ color_imageviews[i], depth_image_views[i], swapchain_imageviews[i] };
         const auto create_info = VkFramebufferCreateInfo{
             .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
             .pNext = nullptr,
             .flags = 0,
             .renderPass = render_pass,
-            .attachmentCount = attachments.size(),
-            .pAttachments = attachments.data(),
+            .attachmentCount = 1,
+            .pAttachments = &swapchain_imageviews[i],
             .width = swapchain_extent.width,
             .height = swapchain_extent.height,
             .layers = 1
@@ -749,24 +953,23 @@ uint32_t find_memory_type_index(VkPhysicalDevice physical_device, uint32_t memor
     throw std::runtime_error("");
 }
 
-VkDeviceMemory allocate_memory(VkDevice logical_device, std::size_t size, uint32_t memory_type_index, cleanup::queue_type& cleanup_queue)
+memory::allocation allocate_memory(memory::device_allocator& allocator, const VkMemoryRequirements& memory_requirements, VkMemoryPropertyFlags memory_flags, bool image, memory::strategy strategy, cleanup::queue_type& cleanup_queue)
 {
-    const auto allocate_info = VkMemoryAllocateInfo{
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = nullptr,
-        .allocationSize = size,
-        .memoryTypeIndex = memory_type_index
-    };
+    const auto allocation = allocator.allocate(memory_requirements, memory_flags, image, strategy);
 
-    auto memory = VkDeviceMemory{};
-    vkAllocateMemory(logical_device, &allocate_info, nullptr, &memory);
+    cleanup_queue.push([&allocator, allocation]() { allocator.free(allocation); });
 
-    cleanup_queue.push([logical_device, memory]() { vkFreeMemory(logical_device, memory, nullptr); });
+    return allocation;
+}
 
-    return memory;
+VkMemoryPropertyFlags transient_attachment_memory_flags(const memory::device_allocator& allocator, const VkMemoryRequirements& memory_requirements)
+{
+    // mostly tilers, the memory is only backed if an attachment ever has to leave tile memory. Desktop gpus don't expose such a type
+    constexpr auto lazily_allocated = VkMemoryPropertyFlags{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT };
+    return allocator.supports(memory_requirements.memoryTypeBits, lazily_allocated) ? lazily_allocated : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 }
 
-std::tuple<VkImage, VkMemoryRequirements> create_color_image(VkDevice logical_device, VkFormat swapchain_format, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue)
+std::tuple<VkImage, VkMemoryRequirements> create_color_image(VkDevice logical_device, VkFormat swapchain_format, VkExtent2D swapchain_extent, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue)
 {
     const auto create_info = VkImageCreateInfo{
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -781,9 +984,9 @@ std::tuple<VkImage, VkMemoryRequirements> create_color_image(VkDevice logical_de
         },
         .mipLevels = 1,
         .arrayLayers = 1,
-        .samples = msaa_samples,
+        .samples = samples,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
         .pQueueFamilyIndices = nullptr,
@@ -801,19 +1004,59 @@ std::tuple<VkImage, VkMemoryRequirements> create_color_image(VkDevice logical_de
     return std::tuple{image, memory_requirements};
 }
 
-std::tuple<VkImage, VkImageView, VkDeviceMemory> create_color_image(VkDevice logical_device, VkPhysicalDevice physical_device, VkFormat swapchain_format, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue)
+std::tuple<VkImage, VkImageView, memory::allocation> create_color_image(VkDevice logical_device, memory::device_allocator& allocator, VkFormat swapchain_format, VkExtent2D swapchain_extent, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue)
 {
-    const auto& [image, memory_requirements] = create_color_image(logical_device, swapchain_format, swapchain_extent, cleanup_queue);
+    const auto& [image, memory_requirements] = create_color_image(logical_device, swapchain_format, swapchain_extent, samples, cleanup_queue);
 
-    const auto memory = allocate_memory(logical_device, memory_requirements.size, find_memory_type_index(physical_device, memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), cleanup_queue);
-    VK_CHECK(vkBindImageMemory(logical_device, image, memory, 0));
+    const auto memory = allocate_memory(allocator, memory_requirements, transient_attachment_memory_flags(allocator, memory_requirements), true, memory::strategy::general, cleanup_queue);
+    VK_CHECK(vkBindImageMemory(logical_device, image, memory.memory, memory.offset));
 
     const auto view = create_color_image_view(logical_device, swapchain_format, image, cleanup_queue);
 
     return std::tuple{image, view, memory};
 }
 
-std::tuple<VkImage, VkMemoryRequirements> create_depth_image(VkDevice logical_device, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue)
+std::tuple<VkImage, VkImageView, memory::allocation> create_render_target(VkDevice logical_device, memory::device_allocator& allocator, VkFormat swapchain_format, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue)
+{
+    const auto create_info = VkImageCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = swapchain_format,
+        .extent = VkExtent3D{
+            .width = swapchain_extent.width,
+            .height = swapchain_extent.height,
+            .depth = 1
+        },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+
+    auto image = VkImage{};
+    VK_CHECK(vkCreateImage(logical_device, &create_info, nullptr, &image));
+
+    cleanup_queue.push([logical_device, image]() { vkDestroyImage(logical_device, image, nullptr); });
+
+    auto memory_requirements = VkMemoryRequirements{};
+    vkGetImageMemoryRequirements(logical_device, image, &memory_requirements);
+
+    const auto memory = allocate_memory(allocator, memory_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, memory::strategy::general, cleanup_queue);
+    VK_CHECK(vkBindImageMemory(logical_device, image, memory.memory, memory.offset));
+
+    const auto view = create_color_image_view(logical_device, swapchain_format, image, cleanup_queue);
+
+    return std::tuple{image, view, memory};
+}
+
+std::tuple<VkImage, VkMemoryRequirements> create_depth_image(VkDevice logical_device, VkFormat depth_format, VkExtent2D swapchain_extent, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue)
 {
     const auto create_info = VkImageCreateInfo{
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -828,9 +1071,9 @@ std::tuple<VkImage, VkMemoryRequirements> create_depth_image(VkDevice logical_de
         },
         .mipLevels = 1,
         .arrayLayers = 1,
-        .samples = msaa_samples,
+        .samples = samples,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
         .pQueueFamilyIndices = nullptr,
@@ -848,7 +1091,7 @@ std::tuple<VkImage, VkMemoryRequirements> create_depth_image(VkDevice logical_de
     return std::tuple{image, memory_requirements};
 }
 
-VkImageView create_depth_image_view(VkDevice logical_device, VkImage image, cleanup::queue_type& cleanup_queue)
+VkImageView create_depth_image_view(VkDevice logical_device, VkFormat depth_format, VkImage image, cleanup::queue_type& cleanup_queue)
 {
     const auto create_info = VkImageViewCreateInfo{
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -880,16 +1123,40 @@ VkImageView create_depth_image_view(VkDevice logical_device, VkImage image, clea
     return view;
 }
 
-std::tuple<VkImage, VkImageView, VkDeviceMemory> create_depth_image(VkDevice logical_device, VkPhysicalDevice physical_device, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue)
+std::tuple<VkImage, VkImageView, memory::allocation> create_depth_image(VkDevice logical_device, memory::device_allocator& allocator, VkFormat depth_format, VkExtent2D swapchain_extent, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue)
 {
-    auto [image, mem_reqs] = create_depth_image(logical_device, swapchain_extent, cleanup_queue);
-    auto memory = allocate_memory(logical_device, mem_reqs.size, find_memory_type_index(physical_device, mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), cleanup_queue);
-    VK_CHECK(vkBindImageMemory(logical_device, image, memory, 0));
-    auto view = create_depth_image_view(logical_device, image, cleanup_queue);
+    auto [image, mem_reqs] = create_depth_image(logical_device, depth_format, swapchain_extent, samples, cleanup_queue);
+    auto memory = allocate_memory(allocator, mem_reqs, transient_attachment_memory_flags(allocator, mem_reqs), true, memory::strategy::general, cleanup_queue);
+    VK_CHECK(vkBindImageMemory(logical_device, image, memory.memory, memory.offset));
+    auto view = create_depth_image_view(logical_device, depth_format, image, cleanup_queue);
 
     return std::tuple{ image, view, memory };
 }
 
+void log_attachment_footprint(const memory::device_allocator& allocator, VkExtent2D extent, std::span<const memory::allocation> transient_memory, std::span<const memory::allocation> stored_memory)
+{
+    constexpr auto mib = 1024. * 1024.;
+    auto attachment_bytes = VkDeviceSize{ 0 };
+    auto committed_bytes = VkDeviceSize{ 0 };
+    auto skipped_bytes = VkDeviceSize{ 0 };
+    for (const auto& memory : transient_memory)
+    {
+        attachment_bytes += memory.size;
+        committed_bytes += allocator.committed_bytes(memory);
+        skipped_bytes += memory.size;
+    }
+    for (const auto& memory : stored_memory)
+    {
+        attachment_bytes += memory.size;
+        committed_bytes += allocator.committed_bytes(memory);
+    }
+    // sizes scale with the pixel count, close enough to guess what a 4K window would take
+    const auto scale_4k = 3840. * 2160. / (static_cast<double>(extent.width) * extent.height);
+
+    spdlog::info("Scene attachments at {}x{}: {:.1f} MiB, {:.1f} MiB at 4K. {:.1f} MiB committed, {:.1f} MiB of stores skipped per frame.",
+        extent.width, extent.height, attachment_bytes / mib, attachment_bytes * scale_4k / mib, committed_bytes / mib, skipped_bytes / mib);
+}
+
 std::tuple<VkBuffer, VkMemoryRequirements> create_buffer(VkDevice logical_device, std::size_t size, VkBufferUsageFlags usage, cleanup::queue_type& cleanup_queue)
 {
     const auto create_info = VkBufferCreateInfo{
@@ -914,24 +1181,20 @@ std::tuple<VkBuffer, VkMemoryRequirements> create_buffer(VkDevice logical_device
     return std::tuple{buffer, memory_requirements};
 }
 
-std::tuple<VkBuffer, VkDeviceMemory> create_buffer(VkDevice logical_device, VkPhysicalDevice physical_device, std::size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags, cleanup::queue_type& cleanup_queue)
+std::tuple<VkBuffer, memory::allocation> create_buffer(VkDevice logical_device, memory::device_allocator& allocator, std::size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags, cleanup::queue_type& cleanup_queue, memory::strategy strategy)
 {
     const auto& [buffer, memory_requirements] = create_buffer(logical_device, size, usage, cleanup_queue);
-    const auto memory = allocate_memory(logical_device, memory_requirements.size, find_memory_type_index(physical_device, memory_requirements.memoryTypeBits, memory_flags), cleanup_queue);
+    const auto memory = allocate_memory(allocator, memory_requirements, memory_flags, false, strategy, cleanup_queue);
 
-    VK_CHECK(vkBindBufferMemory(logical_device, buffer, memory, 0));
+    VK_CHECK(vkBindBufferMemory(logical_device, buffer, memory.memory, memory.offset));
 
     return std::tuple{buffer, memory};
 }
 
-void copy_memory(VkDevice logical_device, VkDeviceMemory device_memory, uint32_t offset, const void* in_data, std::size_t size)
+void copy_memory(const memory::allocation& allocation, std::size_t offset, const void* in_data, std::size_t size)
 {
-    void* pData;
-    VK_CHECK(vkMapMemory(logical_device, device_memory, offset, size, 0, &pData));
-
-    std::memcpy(pData, in_data, size);
-
-    vkUnmapMemory(logical_device, device_memory);
+    assert(allocation.mapped && offset + size <= allocation.size);
+    std::memcpy(reinterpret_cast<char*>(allocation.mapped) + offset, in_data, size);
 }
 
 VkDescriptorSetLayout create_descriptor_sets_layouts(VkDevice logical_device, cleanup::queue_type& cleanup_queue)
@@ -965,6 +1228,27 @@ VkDescriptorSetLayout create_descriptor_sets_layouts(VkDevice logical_device, cl
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
             .pImmutableSamplers = nullptr
+        },
+        VkDescriptorSetLayoutBinding{
+            .binding = 4,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .pImmutableSamplers = nullptr
+        },
+        VkDescriptorSetLayoutBinding{
+            .binding = 5,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .pImmutableSamplers = nullptr
+        },
+        VkDescriptorSetLayoutBinding{
+            .binding = 6,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = nullptr
         }
     };
 
@@ -986,13 +1270,17 @@ VkDescriptorSetLayout create_descriptor_sets_layouts(VkDevice logical_device, cl
 
 VkDescriptorPool create_descriptor_pool(VkDevice logical_device, cleanup::queue_type& cleanup_queue)
 {
-    const auto pool_size = VkDescriptorPoolSize{
-        .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        .descriptorCount = 16 // TODO should be enough for now
+    const auto pool_sizes = std::array{
+        VkDescriptorPoolSize{
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 16 // TODO should be enough for now
+        },
+        VkDescriptorPoolSize{
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 64
+        },
     };
 
-    const auto pool_sizes = std::array { pool_size };
-
     const auto create_info = VkDescriptorPoolCreateInfo{
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .pNext = nullptr,
@@ -1072,6 +1360,30 @@ VkDescriptorUpdateTemplate create_descriptor_update_template(VkDevice logical_de
             .offset = 3*sizeof(VkDescriptorBufferInfo), // TODO lmao, fix this shit. It's an offset in pData array of vkCmdUpdateDescriptorSetWithTemplate
             .stride = 0
         },
+        VkDescriptorUpdateTemplateEntry {
+            .dstBinding = 4,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .offset = 4 * sizeof(VkDescriptorBufferInfo),
+            .stride = 0
+        },
+        VkDescriptorUpdateTemplateEntry {
+            .dstBinding = 5,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .offset = 5 * sizeof(VkDescriptorBufferInfo),
+            .stride = 0
+        },
+        VkDescriptorUpdateTemplateEntry {
+            .dstBinding = 6,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .offset = 6 * sizeof(VkDescriptorBufferInfo),
+            .stride = 0
+        },
     };
 
     const auto create_info = VkDescriptorUpdateTemplateCreateInfo{
@@ -1,11 +1,13 @@
 #pragma once
 
 #include "cleanup.hpp"
+#include "device_allocator.hpp"
 
 #include <Volk/volk.h>
 #include <GLFW/glfw3.h>
 
 #include <optional>
+#include <span>
 #include <string_view>
 #include <vector>
 #include <tuple>
@@ -22,34 +24,55 @@ VkBool32 debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
 void create_debug_utils_messenger(VkInstance vk_instance, cleanup::queue_type& cleanup_queue);
 VkInstance create_vulkan_instance(const std::vector<const char*>& layers, const std::vector<const char*>& extensions, cleanup::queue_type& cleanup_queue);
 bool check_instance_layers(const std::vector<const char*>& requested_layers);
-std::optional<uint32_t> pick_family_index(VkQueueFlagBits bits, const std::vector<VkQueueFamilyProperties>& queue_props);
+// first family supporting any of bits and none of excluded_bits
+std::optional<uint32_t> pick_family_index(VkQueueFlagBits bits, const std::vector<VkQueueFamilyProperties>& queue_props, VkQueueFlags excluded_bits = 0);
+std::vector<VkQueueFamilyProperties> get_queue_family_properties(VkPhysicalDevice physical_device);
 bool check_device_extensions(VkPhysicalDevice device, const std::vector<const char*> required_device_extensions);
 std::tuple<VkPhysicalDevice, uint32_t, VkPhysicalDeviceProperties> pick_physical_device(VkInstance instance, VkSurfaceKHR surface, const std::vector<const char*> required_device_extensions);
-std::tuple<VkDevice, VkQueue> create_logical_device(VkPhysicalDevice physical_device, uint32_t queue_family_index, const std::vector<const char*>& device_extensions, cleanup::queue_type& cleanup_queue);
+// ascending, the counts up to 8 both color and depth attachments support
+std::vector<VkSampleCountFlagBits> get_supported_sample_counts(const VkPhysicalDeviceProperties& properties);
+VkFormat choose_depth_format(VkPhysicalDevice physical_device);
+// the transfer queue is VK_NULL_HANDLE without transfer_queue_family_index
+std::tuple<VkDevice, VkQueue, VkQueue> create_logical_device(VkPhysicalDevice physical_device, uint32_t queue_family_index, std::optional<uint32_t> transfer_queue_family_index, const std::vector<const char*>& device_extensions, cleanup::queue_type& cleanup_queue);
 VkExtent2D choose_extent(const VkSurfaceCapabilitiesKHR& surface_caps, VkExtent2D glfw_framebuffer_extent);
 VkPresentModeKHR choose_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes);
 VkSurfaceFormatKHR choose_image_format(const std::vector<VkSurfaceFormatKHR>& available_formats);
-std::tuple<VkSwapchainKHR, VkSurfaceFormatKHR> create_swapchain(VkDevice logical_device, VkPhysicalDevice physical_device, VkSurfaceKHR surface, uint32_t queue_family_index, VkExtent2D glfw_framebuffer_extent, cleanup::queue_type& cleanup_queue);
+// old_swapchain lets the presentation engine reuse resources, it still has to be destroyed by the caller
+std::tuple<VkSwapchainKHR, VkSurfaceFormatKHR> create_swapchain(VkDevice logical_device, VkPhysicalDevice physical_device, VkSurfaceKHR surface, uint32_t queue_family_index, VkExtent2D glfw_framebuffer_extent, VkSwapchainKHR old_swapchain, cleanup::queue_type& cleanup_queue);
 VkImageView create_color_image_view(VkDevice logical_device, VkFormat format, VkImage image, cleanup::queue_type& cleanup_queue);
 std::tuple<std::vector<VkImage>, std::vector<VkImageView>> get_swapchain_images(VkDevice logical_device, VkSwapchainKHR swapchain, VkFormat image_format, cleanup::queue_type& cleanup_queue);
+// Resolves into the render target when multisampled, renders straight to it otherwise. Leaves it in TRANSFER_SRC_OPTIMAL for the upscale.
 VkRenderPass create_render_pass(VkDevice logical_device, VkFormat swapchain_format, VkFormat depth_format, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue);
+// over the upscaled scene in TRANSFER_DST_OPTIMAL, single sampled so the gui doesn't change with the msaa level
+VkRenderPass create_gui_render_pass(VkDevice logical_device, VkFormat swapchain_format, cleanup::queue_type& cleanup_queue);
+// shared by the scene pipelines
+const VkPipelineMultisampleStateCreateInfo& get_multisample_state(VkSampleCountFlagBits samples);
 VkPipelineLayout create_pipeline_layout(VkDevice logical_device, const std::vector<VkDescriptorSetLayout>& set_layouts, cleanup::queue_type& cleanup_queue);
-std::vector<VkPipeline> create_graphics_pipelines(VkDevice logical_device, const std::vector<VkGraphicsPipelineCreateInfo>& create_infos, cleanup::queue_type& cleanup_queue);
-std::vector<VkFramebuffer> create_swapchain_framebuffers(VkDevice logical_device, VkRenderPass render_pass, const std::vector<VkImageView>& color_imageviews, const std::vector<VkImageView>& swapchain_imageviews, const std::vector<VkImageView> depth_image_views, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue);
+std::vector<VkPipeline> create_graphics_pipelines(VkDevice logical_device, VkPipelineCache pipeline_cache, const std::vector<VkGraphicsPipelineCreateInfo>& create_infos, cleanup::queue_type& cleanup_queue);
+// color_imageviews are the multisampled attachments, empty without msaa
+std::vector<VkFramebuffer> create_scene_framebuffers(VkDevice logical_device, VkRenderPass render_pass, const std::vector<VkImageView>& color_imageviews, const std::vector<VkImageView>& target_imageviews, const std::vector<VkImageView> depth_image_views, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue);
+std::vector<VkFramebuffer> create_gui_framebuffers(VkDevice logical_device, VkRenderPass render_pass, const std::vector<VkImageView>& swapchain_imageviews, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue);
 VkCommandPool create_command_pool(VkDevice logical_device, uint32_t queue_family_index, cleanup::queue_type& cleanup_queue);
 std::vector<VkCommandBuffer> create_command_buffers(VkDevice logical_device, VkCommandPool command_pool, uint32_t count, cleanup::queue_type& cleanup_queue);
 std::vector<VkSemaphore> create_semaphores(VkDevice logical_device, uint32_t count, cleanup::queue_type& cleanup_queue);
 std::vector<VkFence> create_fences(VkDevice logical_device, uint32_t count, cleanup::queue_type& cleanup_queue);
 uint32_t find_memory_type_index(VkPhysicalDevice physical_device, uint32_t memory_type_requirements, VkMemoryPropertyFlags memory_property_flags);
-VkDeviceMemory allocate_memory(VkDevice logical_device, std::size_t size, uint32_t memory_type_index, cleanup::queue_type& cleanup_queue);
-std::tuple<VkImage, VkMemoryRequirements> create_color_image(VkDevice logical_device, VkFormat swapchain_format, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue);
-std::tuple<VkImage, VkImageView, VkDeviceMemory> create_color_image(VkDevice logical_device, VkPhysicalDevice physical_device, VkFormat swapchain_format, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue);
-std::tuple<VkImage, VkMemoryRequirements> create_depth_image(VkDevice logical_device, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue);
-VkImageView create_depth_image_view(VkDevice logical_device, VkImage image, cleanup::queue_type& cleanup_queue);
-std::tuple<VkImage, VkImageView, VkDeviceMemory> create_depth_image(VkDevice logical_device, VkPhysicalDevice physical_device, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue);
+// lazily allocated where some memory type allows it, for images with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+VkMemoryPropertyFlags transient_attachment_memory_flags(const memory::device_allocator& allocator, const VkMemoryRequirements& memory_requirements);
+memory::allocation allocate_memory(memory::device_allocator& allocator, const VkMemoryRequirements& memory_requirements, VkMemoryPropertyFlags memory_flags, bool image, memory::strategy strategy, cleanup::queue_type& cleanup_queue);
+std::tuple<VkImage, VkMemoryRequirements> create_color_image(VkDevice logical_device, VkFormat swapchain_format, VkExtent2D swapchain_extent, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue);
+std::tuple<VkImage, VkImageView, memory::allocation> create_color_image(VkDevice logical_device, memory::device_allocator& allocator, VkFormat swapchain_format, VkExtent2D swapchain_extent, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue);
+// the scene renders to a part of it and is blitted to the swapchain image
+std::tuple<VkImage, VkImageView, memory::allocation> create_render_target(VkDevice logical_device, memory::device_allocator& allocator, VkFormat swapchain_format, VkExtent2D swapchain_extent, cleanup::queue_type& cleanup_queue);
+std::tuple<VkImage, VkMemoryRequirements> create_depth_image(VkDevice logical_device, VkFormat depth_format, VkExtent2D swapchain_extent, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue);
+VkImageView create_depth_image_view(VkDevice logical_device, VkFormat depth_format, VkImage image, cleanup::queue_type& cleanup_queue);
+std::tuple<VkImage, VkImageView, memory::allocation> create_depth_image(VkDevice logical_device, memory::device_allocator& allocator, VkFormat depth_format, VkExtent2D swapchain_extent, VkSampleCountFlagBits samples, cleanup::queue_type& cleanup_queue);
+// what the scene attachments cost, transient_memory are the DONT_CARE ones that skip their stores, stored_memory the ones written out
+void log_attachment_footprint(const memory::device_allocator& allocator, VkExtent2D extent, std::span<const memory::allocation> transient_memory, std::span<const memory::allocation> stored_memory);
 std::tuple<VkBuffer, VkMemoryRequirements> create_buffer(VkDevice logical_device, std::size_t size, VkBufferUsageFlags usage, cleanup::queue_type& cleanup_queue);
-std::tuple<VkBuffer, VkDeviceMemory> create_buffer(VkDevice logical_device, VkPhysicalDevice physical_device, std::size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags, cleanup::queue_type& cleanup_queue);
-void copy_memory(VkDevice logical_device, VkDeviceMemory device_memory, uint32_t offset, const void* in_data, std::size_t size);
+std::tuple<VkBuffer, memory::allocation> create_buffer(VkDevice logical_device, memory::device_allocator& allocator, std::size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags, cleanup::queue_type& cleanup_queue, memory::strategy strategy = memory::strategy::general);
+// allocation has to be host visible
+void copy_memory(const memory::allocation& allocation, std::size_t offset, const void* in_data, std::size_t size);
 VkDescriptorSetLayout create_descriptor_sets_layouts(VkDevice logical_device, cleanup::queue_type& cleanup_queue);
 VkDescriptorPool create_descriptor_pool(VkDevice logical_device, cleanup::queue_type& cleanup_queue);
 std::vector<VkDescriptorSet> allocate_descriptor_sets(VkDevice logical_device, const std::vector<VkDescriptorSetLayout>& in_set_layouts, const VkDescriptorPool& pool, std::size_t frame_overlap);
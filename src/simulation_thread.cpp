@@ -0,0 +1,113 @@
+#include "simulation_thread.hpp"
+#include "aquarium_bounds.hpp"
+#include "cpu_profiler.hpp"
+
+#include <algorithm>
+
+namespace boids
+{
+    namespace
+    {
+        // same as the render loop, catching up on more would only make the next round slower still
+        constexpr auto max_ticks_per_advance = uint32_t{ 4 };
+    }
+
+    float snapshot::interpolation(std::chrono::steady_clock::time_point now) const
+    {
+        return std::clamp(static_cast<float>(std::chrono::duration<double>(now - time).count() / tick_seconds), 0.f, 1.f);
+    }
+
+    simulation_thread::simulation_thread(std::size_t count, const parameters& params, float wall_force_weight, float tick_rate, std::size_t thread_count)
+        : _flock(count),
+          _params(params),
+          _wall_force_weight(wall_force_weight),
+          _repellents(aquarium::get_wall_repellents(aquarium::min_range, aquarium::max_range, _wall_force_weight)),
+          _clock(tick_rate, max_ticks_per_advance),
+          _pool(thread_count)
+    {
+        spawn(_flock, aquarium::min_range, aquarium::max_range);
+
+        // readers get the spawned flock until the first tick
+        capture(_flock, _snapshots.back().previous);
+        publish();
+
+        _thread = std::thread([this]() { run(); });
+    }
+
+    simulation_thread::~simulation_thread()
+    {
+        _stop.store(true, std::memory_order_relaxed);
+        _thread.join();
+    }
+
+    bool simulation_thread::post(const message& message)
+    {
+        return _messages.push(message);
+    }
+
+    void simulation_thread::run()
+    {
+        using clock = std::chrono::steady_clock;
+        profiling::set_thread_name("simulation");
+
+        auto last_time = clock::now();
+        while (!_stop.load(std::memory_order_relaxed))
+        {
+            while (const auto message = _messages.pop())
+            {
+                apply(*message);
+            }
+
+            const auto now = clock::now();
+            const auto ticks = _clock.advance(std::chrono::duration<double>(now - last_time).count());
+            last_time = now;
+
+            for (auto tick = uint32_t{ 0 }; tick < ticks; ++tick)
+            {
+                const auto zone = profiling::scoped_zone("tick");
+                capture(_flock, _snapshots.back().previous);
+                step(_flock, _sorted, _neighbours, _params, _repellents, aquarium::min_range, aquarium::max_range, _pool);
+                publish();
+            }
+
+            // at most one tick long, so messages and stopping wait at most that
+            std::this_thread::sleep_for(std::chrono::duration<double>(_clock.seconds_until_next_tick()));
+        }
+    }
+
+    void simulation_thread::apply(const message& message)
+    {
+        if (const auto* set_parameters = std::get_if<messages::set_parameters>(&message))
+        {
+            _params = set_parameters->params;
+            _wall_force_weight = set_parameters->wall_force_weight;
+        }
+        else if (const auto* set_tick_rate = std::get_if<messages::set_tick_rate>(&message))
+        {
+            _clock.set_tick_rate(set_tick_rate->tick_rate);
+        }
+        else if (const auto* set_count = std::get_if<messages::set_count>(&message))
+        {
+            const auto previous_count = _flock.size();
+            _flock.resize(set_count->count);
+            spawn(_flock, aquarium::min_range, aquarium::max_range, previous_count);
+        }
+        else if (const auto* set_color = std::get_if<messages::set_color>(&message))
+        {
+            if (set_color->index < _flock.size())
+            {
+                _flock.colors[set_color->index] = set_color->color;
+            }
+        }
+    }
+
+    void simulation_thread::publish()
+    {
+        auto& snapshot = _snapshots.back();
+        // copy assignment keeps the slot's capacity, so this doesn't allocate once the flock stopped growing
+        snapshot.current = _flock;
+        snapshot.time = std::chrono::steady_clock::now();
+        snapshot.tick_seconds = 1. / _clock.tick_rate();
+        _snapshots.publish();
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "fixed_timestep.hpp"
+#include "flock.hpp"
+#include "spsc_queue.hpp"
+#include "thread_pool.hpp"
+#include "triple_buffer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <variant>
+
+namespace boids
+{
+    // One published tick: the flock after it and the poses from before it, to interpolate in between
+    struct snapshot
+    {
+        flock current;
+        poses previous;
+        std::chrono::steady_clock::time_point time;
+        double tick_seconds = 0.;
+
+        // how far `now` is between previous and current, drawing runs one tick behind the simulation
+        float interpolation(std::chrono::steady_clock::time_point now) const;
+    };
+
+    namespace messages
+    {
+        struct set_parameters
+        {
+            parameters params;
+            float wall_force_weight;
+
+            bool operator==(const set_parameters&) const = default;
+        };
+
+        struct set_tick_rate
+        {
+            float tick_rate;
+        };
+
+        // despawns from the end or spawns new boids at random
+        struct set_count
+        {
+            std::size_t count;
+        };
+
+        struct set_color
+        {
+            std::size_t index;
+            glm::vec4 color;
+        };
+    }
+
+    using message = std::variant<messages::set_parameters, messages::set_tick_rate, messages::set_count, messages::set_color>;
+
+    // Runs boids::step at a fixed tick rate on its own thread, with its own pool, so the simulation cost doesn't add to frame time.
+    // The flock is only touched by that thread. Everybody else sends messages through post() and reads published ticks from latest(), neither blocks.
+    class simulation_thread final
+    {
+    public:
+        // thread_count includes the simulation thread itself, like jobs::thread_pool
+        simulation_thread(std::size_t count, const parameters& params, float wall_force_weight, float tick_rate, std::size_t thread_count);
+        ~simulation_thread();
+
+        simulation_thread(const simulation_thread&) = delete;
+        simulation_thread(simulation_thread&&) = delete;
+        simulation_thread& operator=(const simulation_thread&) = delete;
+        simulation_thread& operator=(simulation_thread&&) = delete;
+
+        // Only ever from one thread. False when the queue is full, post it again later.
+        bool post(const message& message);
+        // Only ever from one thread. Latest published tick, valid until the next call.
+        const snapshot& latest() { return _snapshots.latest(); }
+
+    private:
+        void run();
+        void apply(const message& message);
+        void publish();
+
+        flock _flock;
+        sorted_flock _sorted;
+        spatial_hash _neighbours;
+        parameters _params;
+        float _wall_force_weight;
+        std::array<plane_repellent, 6> _repellents;
+        timing::fixed_timestep _clock;
+        jobs::thread_pool _pool;
+
+        concurrency::triple_buffer<snapshot> _snapshots;
+        concurrency::spsc_queue<message, 256> _messages;
+        std::atomic<bool> _stop = false;
+        // last, everything above has to exist before the thread starts
+        std::thread _thread;
+    };
+}
@@ -0,0 +1,135 @@
+#include "spatial_hash.hpp"
+#include "boids.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <limits>
+
+namespace boids
+{
+    namespace
+    {
+        // anything smaller would only produce empty cells and int overflow for far away boids
+        constexpr auto min_cell_size = 1e-3f;
+    }
+
+    template<typename F>
+    void spatial_hash::rebuild(std::size_t count, float cell_size, F&& position)
+    {
+        assert(count < std::numeric_limits<uint32_t>::max());
+
+        _cell_size = std::max(cell_size, min_cell_size);
+
+        // ~2 buckets per boid keeps collisions between unrelated cells low
+        const auto bucket_count = std::bit_ceil(std::max<uint32_t>(2 * static_cast<uint32_t>(count), 1));
+        _bucket_mask = bucket_count - 1;
+
+        _bucket_start.assign(bucket_count + 1, 0);
+        _boid_bucket.resize(count);
+        _entries.resize(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto b = bucket(cell(position(i)));
+            _boid_bucket[i] = b;
+            _bucket_start[b + 1]++;
+        }
+
+        for (std::size_t b = 0; b < bucket_count; ++b)
+        {
+            _bucket_start[b + 1] += _bucket_start[b];
+        }
+
+        _bucket_cursor.assign(_bucket_start.begin(), _bucket_start.end() - 1);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            _entries[_bucket_cursor[_boid_bucket[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    void spatial_hash::rebuild(const std::vector<boid>& boids, float cell_size)
+    {
+        rebuild(boids.size(), cell_size, [&boids](std::size_t i) { return glm::vec3(boids[i].position); });
+    }
+
+    void spatial_hash::rebuild(std::span<const float> x, std::span<const float> y, std::span<const float> z, float cell_size)
+    {
+        assert(x.size() == y.size() && x.size() == z.size());
+        rebuild(x.size(), cell_size, [x, y, z](std::size_t i) { return glm::vec3(x[i], y[i], z[i]); });
+    }
+
+    glm::ivec3 spatial_hash::cell(const glm::vec3& position) const
+    {
+        return glm::ivec3(glm::floor(position / _cell_size));
+    }
+
+    uint32_t spatial_hash::bucket(const glm::ivec3& cell) const
+    {
+        // Teschner et al. "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+        const auto h = (static_cast<uint32_t>(cell.x) * 73856093u) ^ (static_cast<uint32_t>(cell.y) * 19349663u) ^ (static_cast<uint32_t>(cell.z) * 83492791u);
+        return h & _bucket_mask;
+    }
+
+    std::span<const uint32_t> spatial_hash::query_buckets(const glm::vec3& position, float radius, std::array<uint32_t, max_query_buckets>& buckets) const
+    {
+        assert(radius <= _cell_size);
+
+        // a bit of slack, because the caller's distance test rounds too - flooring the box corners must not miss a cell
+        const auto extent = radius * (1.f + 1e-4f);
+        const auto min_cell = cell(position - extent);
+        const auto max_cell = cell(position + extent);
+
+        // Neighbouring cells may hash to the same bucket, which must not be visited twice. Only a handful of buckets are non-empty,
+        // so insertion sort dedups them far cheaper than sorting all of the bucket ids.
+        auto count = std::size_t{ 0 };
+        for (auto z = min_cell.z; z <= max_cell.z; ++z)
+        {
+            for (auto y = min_cell.y; y <= max_cell.y; ++y)
+            {
+                for (auto x = min_cell.x; x <= max_cell.x; ++x)
+                {
+                    const auto b = bucket({ x, y, z });
+                    if (_bucket_start[b] == _bucket_start[b + 1])
+                    {
+                        continue;
+                    }
+
+                    auto slot = count;
+                    while (slot > 0 && buckets[slot - 1] > b)
+                    {
+                        slot--;
+                    }
+
+                    if (slot > 0 && buckets[slot - 1] == b)
+                    {
+                        continue;
+                    }
+
+                    assert(count < buckets.size());
+                    std::move_backward(buckets.begin() + slot, buckets.begin() + count, buckets.begin() + count + 1);
+                    buckets[slot] = b;
+                    count++;
+                }
+            }
+        }
+
+        return std::span(buckets.data(), count);
+    }
+
+    std::span<const spatial_hash::range> spatial_hash::candidate_ranges(const glm::vec3& position, float radius, std::array<range, max_query_buckets>& ranges) const
+    {
+        auto buckets = std::array<uint32_t, max_query_buckets>{};
+
+        auto count = std::size_t{ 0 };
+        for (const auto bucket : query_buckets(position, radius, buckets))
+        {
+            if (_bucket_start[bucket] != _bucket_start[bucket + 1])
+            {
+                ranges[count++] = range{ _bucket_start[bucket], _bucket_start[bucket + 1] };
+            }
+        }
+
+        return std::span(ranges.data(), count);
+    }
+}
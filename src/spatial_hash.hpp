@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace boids
+{
+    struct boid;
+
+    // Uniform grid over the flock, hashed into a fixed number of buckets so that memory stays O(N) regardless of cell size.
+    // Rebuilt from scratch every tick - counting sort, so bucket contents keep ascending boid index order.
+    class spatial_hash final
+    {
+    public:
+        // range of entries()
+        struct range
+        {
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        // query box spans at most 3 cells per axis, 4 when rounding puts it right on a cell border
+        static constexpr auto max_query_buckets = 4 * 4 * 4;
+
+        // cell_size has to be >= the radius later passed to for_each_candidate, otherwise neighbours get missed
+        void rebuild(const std::vector<boid>& boids, float cell_size);
+        void rebuild(std::span<const float> x, std::span<const float> y, std::span<const float> z, float cell_size);
+
+        // Non-empty ranges of every bucket overlapping the box [position - radius, position + radius], each bucket at most once.
+        std::span<const range> candidate_ranges(const glm::vec3& position, float radius, std::array<range, max_query_buckets>& ranges) const;
+
+        // Calls f(begin, end) for every range from candidate_ranges.
+        template<typename F>
+        void for_each_candidate_range(const glm::vec3& position, float radius, F&& f) const
+        {
+            auto ranges = std::array<range, max_query_buckets>{};
+            for (const auto& [begin, end] : candidate_ranges(position, radius, ranges))
+            {
+                f(begin, end);
+            }
+        }
+
+        // Calls f(index) for every boid from buckets overlapping the box [position - radius, position + radius].
+        // Each boid is visited at most once, but order is bucket order, not index order.
+        template<typename F>
+        void for_each_candidate(const glm::vec3& position, float radius, F&& f) const
+        {
+            for_each_candidate_range(position, radius, [&](uint32_t begin, uint32_t end) {
+                for (auto i = begin; i < end; ++i)
+                {
+                    f(_entries[i]);
+                }
+            });
+        }
+
+        // boid indices sorted by bucket
+        std::span<const uint32_t> entries() const { return _entries; }
+        float cell_size() const { return _cell_size; }
+
+    private:
+        template<typename F>
+        void rebuild(std::size_t count, float cell_size, F&& position);
+
+        glm::ivec3 cell(const glm::vec3& position) const;
+        uint32_t bucket(const glm::ivec3& cell) const;
+        std::span<const uint32_t> query_buckets(const glm::vec3& position, float radius, std::array<uint32_t, max_query_buckets>& buckets) const;
+
+        float _cell_size = 1.f;
+        uint32_t _bucket_mask = 0;
+        std::vector<uint32_t> _bucket_start;
+        std::vector<uint32_t> _bucket_cursor;
+        std::vector<uint32_t> _boid_bucket;
+        std::vector<uint32_t> _entries;
+    };
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <optional>
+
+namespace concurrency
+{
+    // Lock-free bounded queue for exactly one producer and one consumer thread
+    template<typename T, std::size_t Capacity>
+    class spsc_queue final
+    {
+        static_assert(std::has_single_bit(Capacity));
+
+    public:
+        // producer side, false when full
+        bool push(const T& value)
+        {
+            const auto tail = _tail.load(std::memory_order_relaxed);
+            if (tail - _head.load(std::memory_order_acquire) == Capacity)
+            {
+                return false;
+            }
+
+            _items[tail & (Capacity - 1)] = value;
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side
+        std::optional<T> pop()
+        {
+            const auto head = _head.load(std::memory_order_relaxed);
+            if (head == _tail.load(std::memory_order_acquire))
+            {
+                return std::nullopt;
+            }
+
+            auto value = std::move(_items[head & (Capacity - 1)]);
+            _head.store(head + 1, std::memory_order_release);
+            return value;
+        }
+
+    private:
+        std::array<T, Capacity> _items;
+        alignas(64) std::atomic<std::size_t> _head = 0;
+        alignas(64) std::atomic<std::size_t> _tail = 0;
+    };
+}
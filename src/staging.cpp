@@ -0,0 +1,174 @@
+#include "staging.hpp"
+#include "setup.hpp"
+#include "vkcheck.hpp"
+
+namespace staging
+{
+    namespace
+    {
+        // a frame stages instances and both light arrays
+        constexpr auto expected_copies = std::size_t{ 8 };
+    }
+
+    bool is_unified_memory(const VkPhysicalDeviceProperties& properties)
+    {
+        return properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU || properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+    }
+
+    void* frame_buffer::data(std::size_t frame_index) const
+    {
+        return reinterpret_cast<char*>(host_data) + frame_index * slice_size;
+    }
+
+    VkDescriptorBufferInfo frame_buffer::buffer_info(std::size_t frame_index) const
+    {
+        return VkDescriptorBufferInfo{
+            .buffer = device_buffer != VK_NULL_HANDLE ? device_buffer : host_buffer,
+            .offset = frame_index * slice_size,
+            .range = slice_size
+        };
+    }
+
+    frame_buffer create_frame_buffer(VkDevice logical_device, memory::device_allocator& allocator, std::size_t frames_in_flight, std::size_t size, std::size_t alignment, VkBufferUsageFlags usage, bool device_local, memory::strategy strategy, cleanup::queue_type& cleanup_queue)
+    {
+        auto buffer = frame_buffer{
+            .slice_size = pad_uniform_buffer_size(size, alignment)
+        };
+
+        const auto& [host_buffer, host_memory] = create_buffer(logical_device, allocator, frames_in_flight * buffer.slice_size, usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, cleanup_queue, strategy);
+        buffer.host_buffer = host_buffer;
+        buffer.host_data = host_memory.mapped;
+
+        if (device_local)
+        {
+            buffer.device_buffer = std::get<0>(create_buffer(logical_device, allocator, frames_in_flight * buffer.slice_size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cleanup_queue, strategy));
+        }
+
+        return buffer;
+    }
+
+    uploader::uploader(VkDevice logical_device, uint32_t graphics_queue_family, std::optional<uint32_t> transfer_queue_family, VkQueue transfer_queue, std::size_t frames_in_flight, cleanup::queue_type& cleanup_queue)
+        : _device(logical_device), _graphics_queue_family(graphics_queue_family), _transfer_queue_family(transfer_queue_family), _transfer_queue(transfer_queue)
+    {
+        if (_transfer_queue_family)
+        {
+            const auto command_pool = create_command_pool(logical_device, *_transfer_queue_family, cleanup_queue);
+            _command_buffers = create_command_buffers(logical_device, command_pool, static_cast<uint32_t>(frames_in_flight), cleanup_queue);
+            _semaphores = create_semaphores(logical_device, static_cast<uint32_t>(frames_in_flight), cleanup_queue);
+        }
+
+        _pending.reserve(expected_copies);
+        _barriers.reserve(expected_copies);
+    }
+
+    void uploader::copy(const frame_buffer& buffer, std::size_t frame_index, std::size_t size)
+    {
+        if (buffer.device_buffer == VK_NULL_HANDLE || size == 0)
+        {
+            return;
+        }
+
+        _pending.push_back(pending_copy{
+            .src = buffer.host_buffer,
+            .dst = buffer.device_buffer,
+            .region = VkBufferCopy{
+                .srcOffset = frame_index * buffer.slice_size,
+                .dstOffset = frame_index * buffer.slice_size,
+                .size = size
+            }
+        });
+    }
+
+    VkSemaphore uploader::flush(std::size_t frame_index, VkCommandBuffer graphics_command_buffer)
+    {
+        if (_pending.empty())
+        {
+            return VK_NULL_HANDLE;
+        }
+
+        // Device slices of this frame were last read by draws behind the frame's fence, nothing to wait for before overwriting them.
+        // Their old contents don't matter either, so ownership never has to go back to the transfer family.
+        if (!_transfer_queue_family)
+        {
+            record_copies(graphics_command_buffer);
+
+            const auto barrier = VkMemoryBarrier{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+            };
+            vkCmdPipelineBarrier(graphics_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+            _pending.clear();
+            return VK_NULL_HANDLE;
+        }
+
+        // the graphics submit that waited on this frame's semaphore last time is behind the same fence, so is the command buffer
+        const auto command_buffer = _command_buffers[frame_index];
+        const auto semaphore = _semaphores[frame_index];
+
+        const auto begin_info = VkCommandBufferBeginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = nullptr
+        };
+        VK_CHECK(vkResetCommandBuffer(command_buffer, 0));
+        VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+
+        record_copies(command_buffer);
+        // release, dst masks are ignored on this side
+        ownership_barriers(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+
+        VK_CHECK(vkEndCommandBuffer(command_buffer));
+
+        const auto submit_info = VkSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = nullptr,
+            .waitSemaphoreCount = 0,
+            .pWaitSemaphores = nullptr,
+            .pWaitDstStageMask = nullptr,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &command_buffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &semaphore,
+        };
+        VK_CHECK(vkQueueSubmit(_transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+
+        // acquire, src masks are ignored on this side but the stage has to chain with the semaphore wait
+        ownership_barriers(graphics_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+        _pending.clear();
+        return semaphore;
+    }
+
+    void uploader::record_copies(VkCommandBuffer command_buffer) const
+    {
+        for (const auto& pending : _pending)
+        {
+            vkCmdCopyBuffer(command_buffer, pending.src, pending.dst, 1, &pending.region);
+        }
+    }
+
+    void uploader::ownership_barriers(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stages, VkAccessFlags src_access, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+    {
+        _barriers.clear();
+        for (const auto& pending : _pending)
+        {
+            _barriers.push_back(VkBufferMemoryBarrier{
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = src_access,
+                .dstAccessMask = dst_access,
+                .srcQueueFamilyIndex = *_transfer_queue_family,
+                .dstQueueFamilyIndex = _graphics_queue_family,
+                .buffer = pending.dst,
+                .offset = pending.region.dstOffset,
+                .size = pending.region.size
+            });
+        }
+
+        vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(_barriers.size()), _barriers.data(), 0, nullptr);
+    }
+}
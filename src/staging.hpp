@@ -0,0 +1,73 @@
+#pragma once
+
+#include "cleanup.hpp"
+#include "device_allocator.hpp"
+
+#include <Volk/volk.h>
+
+#include <optional>
+#include <vector>
+
+namespace staging
+{
+    // Integrated and cpu devices have one memory pool, a staging copy would only double the traffic.
+    bool is_unified_memory(const VkPhysicalDeviceProperties& properties);
+
+    // Data written on the cpu and read by shaders, one slice per frame in flight.
+    // With a device_buffer the host visible slices are only staging, uploader copies them over before drawing. Without one shaders read host memory directly.
+    struct frame_buffer
+    {
+        VkBuffer host_buffer = VK_NULL_HANDLE;
+        VkBuffer device_buffer = VK_NULL_HANDLE;
+        void* host_data = nullptr;
+        std::size_t slice_size = 0;
+
+        void* data(std::size_t frame_index) const;
+        // the slice shaders read
+        VkDescriptorBufferInfo buffer_info(std::size_t frame_index) const;
+    };
+
+    // usage is what shaders need, transfer usages are added on top. The host buffer is always a valid transfer source.
+    frame_buffer create_frame_buffer(VkDevice logical_device, memory::device_allocator& allocator, std::size_t frames_in_flight, std::size_t size, std::size_t alignment, VkBufferUsageFlags usage, bool device_local, memory::strategy strategy, cleanup::queue_type& cleanup_queue);
+
+    // Copies staged frame_buffer slices to their device local slices once per frame.
+    // With a dedicated transfer family the copies run on their own queue and ownership of the copied ranges is handed over to graphics_queue_family,
+    // otherwise they're recorded into the frame's graphics command buffer.
+    class uploader final
+    {
+    public:
+        uploader(VkDevice logical_device, uint32_t graphics_queue_family, std::optional<uint32_t> transfer_queue_family, VkQueue transfer_queue, std::size_t frames_in_flight, cleanup::queue_type& cleanup_queue);
+
+        uploader(const uploader&) = delete;
+        uploader(uploader&&) = delete;
+        uploader& operator=(const uploader&) = delete;
+        uploader& operator=(uploader&&) = delete;
+
+        // copies the first size bytes of frame_index's slice, nothing to do for buffers shaders read directly
+        void copy(const frame_buffer& buffer, std::size_t frame_index, std::size_t size);
+
+        // Call before the render pass begins, once the frame's fence was waited for. Everything copied ahead of it is visible to compute, vertex and fragment shaders in graphics_command_buffer.
+        // Returns the semaphore the graphics submit has to wait on at the compute and vertex shader stages, VK_NULL_HANDLE when there's none.
+        VkSemaphore flush(std::size_t frame_index, VkCommandBuffer graphics_command_buffer);
+
+    private:
+        struct pending_copy
+        {
+            VkBuffer src;
+            VkBuffer dst;
+            VkBufferCopy region;
+        };
+
+        void record_copies(VkCommandBuffer command_buffer) const;
+        void ownership_barriers(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stages, VkAccessFlags src_access, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access);
+
+        VkDevice _device;
+        uint32_t _graphics_queue_family;
+        std::optional<uint32_t> _transfer_queue_family;
+        VkQueue _transfer_queue;
+        std::vector<VkCommandBuffer> _command_buffers;
+        std::vector<VkSemaphore> _semaphores;
+        std::vector<pending_copy> _pending;
+        std::vector<VkBufferMemoryBarrier> _barriers;
+    };
+}
@@ -0,0 +1,322 @@
+#include "steer_kernels.hpp"
+
+#include <array>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
+namespace boids::kernels
+{
+    neighbour_sums accumulate_scalar(const candidates& c, const spatial_hash::range* ranges, std::size_t range_count, uint32_t self, float px, float py, float pz, float visual_range2)
+    {
+        auto sums = neighbour_sums{};
+        for (std::size_t r = 0; r < range_count; ++r)
+        {
+            for (auto j = ranges[r].begin; j < ranges[r].end; ++j)
+            {
+                const auto dx = px - c.x[j];
+                const auto dy = py - c.y[j];
+                const auto dz = pz - c.z[j];
+                const auto distance2 = dx * dx + dy * dy + dz * dz;
+                if (j != self && distance2 < visual_range2)
+                {
+                    const auto inv_distance = 1.f / std::sqrt(distance2);
+                    sums.count += 1.f;
+                    sums.cx += c.x[j];
+                    sums.cy += c.y[j];
+                    sums.cz += c.z[j];
+                    sums.sx += dx * inv_distance;
+                    sums.sy += dy * inv_distance;
+                    sums.sz += dz * inv_distance;
+                    sums.ax += c.vx[j];
+                    sums.ay += c.vy[j];
+                    sums.az += c.vz[j];
+                }
+            }
+        }
+
+        return sums;
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    namespace
+    {
+        float horizontal_sum(__m128 v)
+        {
+            auto lanes = std::array<float, 4>{};
+            _mm_storeu_ps(lanes.data(), v);
+            return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+    }
+
+    neighbour_sums accumulate_sse2(const candidates& c, const spatial_hash::range* ranges, std::size_t range_count, uint32_t self, float px, float py, float pz, float visual_range2)
+    {
+        const auto position_x = _mm_set1_ps(px);
+        const auto position_y = _mm_set1_ps(py);
+        const auto position_z = _mm_set1_ps(pz);
+        const auto range2 = _mm_set1_ps(visual_range2);
+        const auto one = _mm_set1_ps(1.f);
+        const auto self_index = _mm_set1_epi32(static_cast<int>(self));
+        const auto lane = _mm_setr_epi32(0, 1, 2, 3);
+
+        auto count = _mm_setzero_ps();
+        auto cx = _mm_setzero_ps(), cy = _mm_setzero_ps(), cz = _mm_setzero_ps();
+        auto sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+        auto ax = _mm_setzero_ps(), ay = _mm_setzero_ps(), az = _mm_setzero_ps();
+
+        // 4 lanes wide, so two halves per 8 candidate iteration
+        const auto accumulate_half = [&](uint32_t j, __m128i end) {
+            const auto index = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(j)), lane);
+            const auto valid = _mm_andnot_si128(_mm_cmpeq_epi32(index, self_index), _mm_cmplt_epi32(index, end));
+
+            const auto x = _mm_loadu_ps(c.x + j);
+            const auto y = _mm_loadu_ps(c.y + j);
+            const auto z = _mm_loadu_ps(c.z + j);
+            const auto dx = _mm_sub_ps(position_x, x);
+            const auto dy = _mm_sub_ps(position_y, y);
+            const auto dz = _mm_sub_ps(position_z, z);
+            const auto distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            const auto mask = _mm_and_ps(_mm_cmplt_ps(distance2, range2), _mm_castsi128_ps(valid));
+            // masked lanes may hold inf/nan (self is at distance 0), and-ing clears them
+            const auto inv_distance = _mm_div_ps(one, _mm_sqrt_ps(distance2));
+
+            count = _mm_add_ps(count, _mm_and_ps(mask, one));
+            cx = _mm_add_ps(cx, _mm_and_ps(mask, x));
+            cy = _mm_add_ps(cy, _mm_and_ps(mask, y));
+            cz = _mm_add_ps(cz, _mm_and_ps(mask, z));
+            sx = _mm_add_ps(sx, _mm_and_ps(mask, _mm_mul_ps(dx, inv_distance)));
+            sy = _mm_add_ps(sy, _mm_and_ps(mask, _mm_mul_ps(dy, inv_distance)));
+            sz = _mm_add_ps(sz, _mm_and_ps(mask, _mm_mul_ps(dz, inv_distance)));
+            ax = _mm_add_ps(ax, _mm_and_ps(mask, _mm_loadu_ps(c.vx + j)));
+            ay = _mm_add_ps(ay, _mm_and_ps(mask, _mm_loadu_ps(c.vy + j)));
+            az = _mm_add_ps(az, _mm_and_ps(mask, _mm_loadu_ps(c.vz + j)));
+        };
+
+        for (std::size_t r = 0; r < range_count; ++r)
+        {
+            const auto end = _mm_set1_epi32(static_cast<int>(ranges[r].end));
+            for (auto j = ranges[r].begin; j < ranges[r].end; j += 8)
+            {
+                accumulate_half(j, end);
+                if (j + 4 < ranges[r].end)
+                {
+                    accumulate_half(j + 4, end);
+                }
+            }
+        }
+
+        return neighbour_sums{
+            .count = horizontal_sum(count),
+            .cx = horizontal_sum(cx), .cy = horizontal_sum(cy), .cz = horizontal_sum(cz),
+            .sx = horizontal_sum(sx), .sy = horizontal_sum(sy), .sz = horizontal_sum(sz),
+            .ax = horizontal_sum(ax), .ay = horizontal_sum(ay), .az = horizontal_sum(az),
+        };
+    }
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+    neighbour_sums accumulate_neon(const candidates& c, const spatial_hash::range* ranges, std::size_t range_count, uint32_t self, float px, float py, float pz, float visual_range2)
+    {
+        const auto position_x = vdupq_n_f32(px);
+        const auto position_y = vdupq_n_f32(py);
+        const auto position_z = vdupq_n_f32(pz);
+        const auto range2 = vdupq_n_f32(visual_range2);
+        const auto one = vdupq_n_f32(1.f);
+        const auto self_index = vdupq_n_u32(self);
+        const auto lane_values = std::array<uint32_t, 4>{ 0, 1, 2, 3 };
+        const auto lane = vld1q_u32(lane_values.data());
+
+        auto count = vdupq_n_f32(0.f);
+        auto cx = vdupq_n_f32(0.f), cy = vdupq_n_f32(0.f), cz = vdupq_n_f32(0.f);
+        auto sx = vdupq_n_f32(0.f), sy = vdupq_n_f32(0.f), sz = vdupq_n_f32(0.f);
+        auto ax = vdupq_n_f32(0.f), ay = vdupq_n_f32(0.f), az = vdupq_n_f32(0.f);
+
+        const auto masked = [](uint32x4_t mask, float32x4_t v) { return vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(v))); };
+
+        // 4 lanes wide, so two halves per 8 candidate iteration
+        const auto accumulate_half = [&](uint32_t j, uint32x4_t end) {
+            const auto index = vaddq_u32(vdupq_n_u32(j), lane);
+            const auto valid = vbicq_u32(vcltq_u32(index, end), vceqq_u32(index, self_index));
+
+            const auto x = vld1q_f32(c.x + j);
+            const auto y = vld1q_f32(c.y + j);
+            const auto z = vld1q_f32(c.z + j);
+            const auto dx = vsubq_f32(position_x, x);
+            const auto dy = vsubq_f32(position_y, y);
+            const auto dz = vsubq_f32(position_z, z);
+            const auto distance2 = vaddq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)), vmulq_f32(dz, dz));
+            const auto mask = vandq_u32(vcltq_f32(distance2, range2), valid);
+            const auto inv_distance = vdivq_f32(one, vsqrtq_f32(distance2));
+
+            count = vaddq_f32(count, masked(mask, one));
+            cx = vaddq_f32(cx, masked(mask, x));
+            cy = vaddq_f32(cy, masked(mask, y));
+            cz = vaddq_f32(cz, masked(mask, z));
+            sx = vaddq_f32(sx, masked(mask, vmulq_f32(dx, inv_distance)));
+            sy = vaddq_f32(sy, masked(mask, vmulq_f32(dy, inv_distance)));
+            sz = vaddq_f32(sz, masked(mask, vmulq_f32(dz, inv_distance)));
+            ax = vaddq_f32(ax, masked(mask, vld1q_f32(c.vx + j)));
+            ay = vaddq_f32(ay, masked(mask, vld1q_f32(c.vy + j)));
+            az = vaddq_f32(az, masked(mask, vld1q_f32(c.vz + j)));
+        };
+
+        for (std::size_t r = 0; r < range_count; ++r)
+        {
+            const auto end = vdupq_n_u32(ranges[r].end);
+            for (auto j = ranges[r].begin; j < ranges[r].end; j += 8)
+            {
+                accumulate_half(j, end);
+                if (j + 4 < ranges[r].end)
+                {
+                    accumulate_half(j + 4, end);
+                }
+            }
+        }
+
+        return neighbour_sums{
+            .count = vaddvq_f32(count),
+            .cx = vaddvq_f32(cx), .cy = vaddvq_f32(cy), .cz = vaddvq_f32(cz),
+            .sx = vaddvq_f32(sx), .sy = vaddvq_f32(sy), .sz = vaddvq_f32(sz),
+            .ax = vaddvq_f32(ax), .ay = vaddvq_f32(ay), .az = vaddvq_f32(az),
+        };
+    }
+#endif
+
+    namespace
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        bool cpu_has_avx2()
+        {
+#if defined(_MSC_VER)
+            auto info = std::array<int, 4>{};
+            __cpuid(info.data(), 0);
+            if (info[0] < 7)
+            {
+                return false;
+            }
+
+            __cpuid(info.data(), 1);
+            const auto osxsave = (info[2] & (1 << 27)) != 0;
+            const auto avx = (info[2] & (1 << 28)) != 0;
+            // the os has to save ymm registers on context switch
+            if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            {
+                return false;
+            }
+
+            __cpuidex(info.data(), 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            // may run from a static initializer, before libgcc had a chance to fill in the cpu model
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+
+        accumulate_function get(isa isa)
+        {
+            switch (isa)
+            {
+#if defined(__x86_64__) || defined(_M_X64)
+            case isa::sse2: return &accumulate_sse2;
+            case isa::avx2: return &accumulate_avx2;
+#endif
+#if defined(__aarch64__) || defined(_M_ARM64)
+            case isa::neon: return &accumulate_neon;
+#endif
+            default: return &accumulate_scalar;
+            }
+        }
+
+        struct
+        {
+            kernels::isa instruction_set = detect();
+            accumulate_function function = get(detect());
+        } active_kernel;
+    }
+
+    bool supported(isa isa)
+    {
+        switch (isa)
+        {
+        case isa::scalar: return true;
+#if defined(__x86_64__) || defined(_M_X64)
+        case isa::sse2: return true;
+        case isa::avx2: return cpu_has_avx2();
+#endif
+#if defined(__aarch64__) || defined(_M_ARM64)
+        case isa::neon: return true;
+#endif
+        default: return false;
+        }
+    }
+
+    isa detect()
+    {
+        for (const auto isa : { isa::avx2, isa::neon, isa::sse2 })
+        {
+            if (supported(isa))
+            {
+                return isa;
+            }
+        }
+
+        return isa::scalar;
+    }
+
+    const char* name(isa isa)
+    {
+        switch (isa)
+        {
+        case isa::sse2: return "sse2";
+        case isa::avx2: return "avx2";
+        case isa::neon: return "neon";
+        default: return "scalar";
+        }
+    }
+
+    std::optional<isa> from_name(std::string_view kernel_name)
+    {
+        for (const auto isa : { isa::scalar, isa::sse2, isa::avx2, isa::neon })
+        {
+            if (kernel_name == name(isa))
+            {
+                return isa;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    accumulate_function active()
+    {
+        return active_kernel.function;
+    }
+
+    isa active_isa()
+    {
+        return active_kernel.instruction_set;
+    }
+
+    bool select(isa isa)
+    {
+        if (!supported(isa))
+        {
+            return false;
+        }
+
+        active_kernel.instruction_set = isa;
+        active_kernel.function = get(isa);
+        return true;
+    }
+}
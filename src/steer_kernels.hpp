@@ -0,0 +1,67 @@
+#pragma once
+
+#include "spatial_hash.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace boids::kernels
+{
+    // Candidate arrays have to stay readable this many floats past the last boid - vector loads run over the end of a range and mask the extra lanes off.
+    constexpr auto padding = 8;
+
+    // sorted_flock arrays, see flock.hpp
+    struct candidates
+    {
+        const float* x;
+        const float* y;
+        const float* z;
+        const float* vx;
+        const float* vy;
+        const float* vz;
+    };
+
+    struct neighbour_sums
+    {
+        float count;
+        float cx, cy, cz;
+        float sx, sy, sz;
+        float ax, ay, az;
+    };
+
+    // Sums cohesion, separation and alignment terms over all candidates from ranges, except `self`, that are closer than sqrt(visual_range2).
+    // Kernels only differ in the order floats are added up.
+    using accumulate_function = neighbour_sums (*)(const candidates& candidates, const spatial_hash::range* ranges, std::size_t range_count, uint32_t self, float px, float py, float pz, float visual_range2);
+
+    enum class isa
+    {
+        scalar,
+        sse2,
+        avx2,
+        neon
+    };
+
+    neighbour_sums accumulate_scalar(const candidates& candidates, const spatial_hash::range* ranges, std::size_t range_count, uint32_t self, float px, float py, float pz, float visual_range2);
+#if defined(__x86_64__) || defined(_M_X64)
+    neighbour_sums accumulate_sse2(const candidates& candidates, const spatial_hash::range* ranges, std::size_t range_count, uint32_t self, float px, float py, float pz, float visual_range2);
+    // lives in its own translation unit, compiled with AVX2 enabled - only call it when detect() says so
+    neighbour_sums accumulate_avx2(const candidates& candidates, const spatial_hash::range* ranges, std::size_t range_count, uint32_t self, float px, float py, float pz, float visual_range2);
+#endif
+#if defined(__aarch64__) || defined(_M_ARM64)
+    neighbour_sums accumulate_neon(const candidates& candidates, const spatial_hash::range* ranges, std::size_t range_count, uint32_t self, float px, float py, float pz, float visual_range2);
+#endif
+
+    // best instruction set supported by this cpu
+    isa detect();
+    bool supported(isa isa);
+    const char* name(isa isa);
+    // inverse of name()
+    std::optional<isa> from_name(std::string_view name);
+
+    // kernel used by boids::step. Starts out as detect()
+    accumulate_function active();
+    isa active_isa();
+    // returns false and keeps the current kernel if the cpu can't run the requested one
+    bool select(isa isa);
+}
@@ -0,0 +1,72 @@
+// Compiled with AVX2 enabled (see CMakeLists.txt). Keep this file to intrinsics only - any inline function instantiated here
+// could end up being the one definition the linker picks for the whole program.
+#include "steer_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+
+namespace boids::kernels
+{
+    neighbour_sums accumulate_avx2(const candidates& c, const spatial_hash::range* ranges, std::size_t range_count, uint32_t self, float px, float py, float pz, float visual_range2)
+    {
+        const auto position_x = _mm256_set1_ps(px);
+        const auto position_y = _mm256_set1_ps(py);
+        const auto position_z = _mm256_set1_ps(pz);
+        const auto range2 = _mm256_set1_ps(visual_range2);
+        const auto one = _mm256_set1_ps(1.f);
+        const auto self_index = _mm256_set1_epi32(static_cast<int>(self));
+        const auto lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        auto count = _mm256_setzero_ps();
+        auto cx = _mm256_setzero_ps(), cy = _mm256_setzero_ps(), cz = _mm256_setzero_ps();
+        auto sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps(), sz = _mm256_setzero_ps();
+        auto ax = _mm256_setzero_ps(), ay = _mm256_setzero_ps(), az = _mm256_setzero_ps();
+
+        for (std::size_t r = 0; r < range_count; ++r)
+        {
+            const auto end = _mm256_set1_epi32(static_cast<int>(ranges[r].end));
+            for (auto j = ranges[r].begin; j < ranges[r].end; j += 8)
+            {
+                const auto index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(j)), lane);
+                const auto valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(index, self_index), _mm256_cmpgt_epi32(end, index));
+
+                const auto x = _mm256_loadu_ps(c.x + j);
+                const auto y = _mm256_loadu_ps(c.y + j);
+                const auto z = _mm256_loadu_ps(c.z + j);
+                const auto dx = _mm256_sub_ps(position_x, x);
+                const auto dy = _mm256_sub_ps(position_y, y);
+                const auto dz = _mm256_sub_ps(position_z, z);
+                // no fma, so the distance test matches the other kernels bit for bit
+                const auto distance2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+                const auto mask = _mm256_and_ps(_mm256_cmp_ps(distance2, range2, _CMP_LT_OQ), _mm256_castsi256_ps(valid));
+                // masked lanes may hold inf/nan (self is at distance 0), and-ing clears them
+                const auto inv_distance = _mm256_div_ps(one, _mm256_sqrt_ps(distance2));
+
+                count = _mm256_add_ps(count, _mm256_and_ps(mask, one));
+                cx = _mm256_add_ps(cx, _mm256_and_ps(mask, x));
+                cy = _mm256_add_ps(cy, _mm256_and_ps(mask, y));
+                cz = _mm256_add_ps(cz, _mm256_and_ps(mask, z));
+                sx = _mm256_add_ps(sx, _mm256_and_ps(mask, _mm256_mul_ps(dx, inv_distance)));
+                sy = _mm256_add_ps(sy, _mm256_and_ps(mask, _mm256_mul_ps(dy, inv_distance)));
+                sz = _mm256_add_ps(sz, _mm256_and_ps(mask, _mm256_mul_ps(dz, inv_distance)));
+                ax = _mm256_add_ps(ax, _mm256_and_ps(mask, _mm256_loadu_ps(c.vx + j)));
+                ay = _mm256_add_ps(ay, _mm256_and_ps(mask, _mm256_loadu_ps(c.vy + j)));
+                az = _mm256_add_ps(az, _mm256_and_ps(mask, _mm256_loadu_ps(c.vz + j)));
+            }
+        }
+
+        const auto horizontal_sum = [](__m256 v) {
+            const auto half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+            const auto quarter = _mm_add_ps(half, _mm_movehl_ps(half, half));
+            return _mm_cvtss_f32(_mm_add_ss(quarter, _mm_shuffle_ps(quarter, quarter, 1)));
+        };
+
+        return neighbour_sums{
+            .count = horizontal_sum(count),
+            .cx = horizontal_sum(cx), .cy = horizontal_sum(cy), .cz = horizontal_sum(cz),
+            .sx = horizontal_sum(sx), .sy = horizontal_sum(sy), .sz = horizontal_sum(sz),
+            .ax = horizontal_sum(ax), .ay = horizontal_sum(ay), .az = horizontal_sum(az),
+        };
+    }
+}
+#endif
@@ -0,0 +1,111 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace jobs
+{
+    thread_pool::thread_pool(std::size_t thread_count)
+    {
+        assert(thread_count > 0);
+
+        _workers.reserve(thread_count - 1);
+        for (std::size_t i = 1; i < thread_count; ++i)
+        {
+            _workers.emplace_back([this]() { worker_loop(); });
+        }
+    }
+
+    thread_pool::~thread_pool()
+    {
+        {
+            auto lock = std::scoped_lock(_mutex);
+            _stop = true;
+        }
+        _job_posted.notify_all();
+
+        for (auto& worker : _workers)
+        {
+            worker.join();
+        }
+    }
+
+    void thread_pool::run(std::size_t count, std::size_t chunk_size, job_function function, void* context)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        assert(chunk_size > 0);
+        const auto job = thread_pool::job{
+            .function = function,
+            .context = context,
+            .count = count,
+            .chunk_size = chunk_size,
+            .chunk_count = (count + chunk_size - 1) / chunk_size
+        };
+
+        if (_workers.empty() || job.chunk_count == 1)
+        {
+            function(context, 0, count);
+            return;
+        }
+
+        {
+            auto lock = std::scoped_lock(_mutex);
+            _job = job;
+            _next_chunk.store(0, std::memory_order_relaxed);
+            _job_open = true;
+            _generation++;
+        }
+        _job_posted.notify_all();
+
+        work(job);
+
+        // once every chunk is claimed and nobody is inside work(), all of them are finished.
+        // closing the job under the same lock keeps late risers from touching a context that is about to go out of scope
+        auto lock = std::unique_lock(_mutex);
+        _job_done.wait(lock, [this]() { return _active_workers == 0; });
+        _job_open = false;
+    }
+
+    void thread_pool::work(const job& job)
+    {
+        for (auto chunk = _next_chunk.fetch_add(1, std::memory_order_relaxed); chunk < job.chunk_count; chunk = _next_chunk.fetch_add(1, std::memory_order_relaxed))
+        {
+            const auto begin = chunk * job.chunk_size;
+            const auto end = std::min(begin + job.chunk_size, job.count);
+            job.function(job.context, begin, end);
+        }
+    }
+
+    void thread_pool::worker_loop()
+    {
+        auto seen_generation = uint64_t{ 0 };
+        while (true)
+        {
+            auto job = thread_pool::job{};
+            {
+                auto lock = std::unique_lock(_mutex);
+                _job_posted.wait(lock, [this, seen_generation]() { return _stop || (_job_open && _generation != seen_generation); });
+                if (_stop)
+                {
+                    return;
+                }
+
+                seen_generation = _generation;
+                job = _job;
+                _active_workers++;
+            }
+
+            work(job);
+
+            {
+                auto lock = std::scoped_lock(_mutex);
+                _active_workers--;
+            }
+            _job_done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace jobs
+{
+    // Persistent workers that split a [0, count) range into chunks. The calling thread works on chunks too and parallel_for returns only after all of them are done.
+    // Chunks are claimed dynamically, so the caller has to write results in a way that doesn't depend on which thread got which chunk.
+    class thread_pool final
+    {
+    public:
+        // thread_count includes the calling thread, so 1 means no workers and everything runs inline
+        explicit thread_pool(std::size_t thread_count);
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool(thread_pool&&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+        thread_pool& operator=(thread_pool&&) = delete;
+
+        std::size_t size() const { return _workers.size() + 1; }
+
+        // f(begin, end). Named lambdas deduce F as a reference, possibly const, the context pointer drops both
+        template<typename F>
+        void parallel_for(std::size_t count, std::size_t chunk_size, F&& f)
+        {
+            using function_type = std::remove_reference_t<F>;
+            run(count, chunk_size, [](void* context, std::size_t begin, std::size_t end) { (*static_cast<function_type*>(context))(begin, end); }, const_cast<void*>(static_cast<const void*>(std::addressof(f))));
+        }
+
+    private:
+        using job_function = void(*)(void* context, std::size_t begin, std::size_t end);
+
+        struct job
+        {
+            job_function function = nullptr;
+            void* context = nullptr;
+            std::size_t count = 0;
+            std::size_t chunk_size = 0;
+            std::size_t chunk_count = 0;
+        };
+
+        void run(std::size_t count, std::size_t chunk_size, job_function function, void* context);
+        void work(const job& job);
+        void worker_loop();
+
+        std::vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _job_posted;
+        std::condition_variable _job_done;
+        job _job;
+        uint64_t _generation = 0;
+        bool _job_open = false;
+        std::size_t _active_workers = 0;
+        bool _stop = false;
+        std::atomic<std::size_t> _next_chunk = 0;
+    };
+}
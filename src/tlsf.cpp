@@ -0,0 +1,253 @@
+#include "tlsf.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace memory
+{
+    namespace
+    {
+        struct size_class
+        {
+            uint32_t first_level;
+            uint32_t second_level;
+        };
+
+        // first level is the power of two below size, second level splits it linearly
+        template<uint32_t second_level_log2>
+        size_class classify(uint64_t size)
+        {
+            const auto first_level = static_cast<uint32_t>(std::bit_width(size) - 1);
+            const auto scaled = first_level >= second_level_log2 ? size >> (first_level - second_level_log2) : size << (second_level_log2 - first_level);
+            return size_class{ first_level, static_cast<uint32_t>(scaled ^ (uint64_t{ 1 } << second_level_log2)) };
+        }
+
+        uint64_t align_up(uint64_t offset, uint64_t alignment)
+        {
+            return (offset + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    tlsf::tlsf(uint64_t capacity)
+        : _capacity(capacity)
+    {
+        assert(capacity > 0);
+        for (auto& lists : _free_lists)
+        {
+            lists.fill(null_node);
+        }
+        insert_free(create_node(0, capacity));
+    }
+
+    std::optional<tlsf::range> tlsf::allocate(uint64_t size, uint64_t alignment)
+    {
+        assert(std::has_single_bit(alignment));
+        size = std::max<uint64_t>(size, 1);
+
+        const auto find = [this](uint64_t size) {
+            if (size > _capacity)
+            {
+                return null_node;
+            }
+
+            // round up to the next class, anything in it is big enough
+            auto [first_level, second_level] = classify<second_level_log2>(size);
+            if (first_level >= second_level_log2)
+            {
+                const auto rounded = classify<second_level_log2>(size + (uint64_t{ 1 } << (first_level - second_level_log2)) - 1);
+                first_level = rounded.first_level;
+                second_level = rounded.second_level;
+            }
+
+            auto second_level_map = first_level < first_level_count ? _second_level_bitmaps[first_level] & (~0u << second_level) : 0u;
+            if (second_level_map == 0)
+            {
+                const auto first_level_map = first_level + 1 < first_level_count ? _first_level_bitmap & (~uint64_t{ 0 } << (first_level + 1)) : 0;
+                if (first_level_map == 0)
+                {
+                    return null_node;
+                }
+                first_level = static_cast<uint32_t>(std::countr_zero(first_level_map));
+                second_level_map = _second_level_bitmaps[first_level];
+            }
+            return _free_lists[first_level][std::countr_zero(second_level_map)];
+        };
+
+        // most requests are already aligned, only pay for the worst case padding if the first candidate doesn't fit
+        auto index = find(size);
+        if (index != null_node && align_up(_nodes[index].offset, alignment) + size > _nodes[index].offset + _nodes[index].size)
+        {
+            index = find(size + alignment - 1);
+        }
+        if (index == null_node)
+        {
+            return std::nullopt;
+        }
+
+        remove_free(index);
+
+        const auto padding = align_up(_nodes[index].offset, alignment) - _nodes[index].offset;
+        if (padding > 0)
+        {
+            insert_free(split_front(index, padding));
+        }
+
+        if (_nodes[index].size > size)
+        {
+            // split_front keeps the tail in index, the allocation is the front
+            const auto allocation = split_front(index, size);
+            insert_free(index);
+            index = allocation;
+        }
+
+        _nodes[index].free = false;
+        _used += _nodes[index].size;
+        return range{ _nodes[index].offset, index };
+    }
+
+    void tlsf::free(uint32_t index)
+    {
+        assert(index < _nodes.size() && !_nodes[index].free);
+        _used -= _nodes[index].size;
+
+        const auto previous = _nodes[index].previous_physical;
+        if (previous != null_node && _nodes[previous].free)
+        {
+            remove_free(previous);
+            _nodes[previous].size += _nodes[index].size;
+            _nodes[previous].next_physical = _nodes[index].next_physical;
+            if (_nodes[index].next_physical != null_node)
+            {
+                _nodes[_nodes[index].next_physical].previous_physical = previous;
+            }
+            _unused_nodes.push_back(index);
+            index = previous;
+        }
+
+        const auto next = _nodes[index].next_physical;
+        if (next != null_node && _nodes[next].free)
+        {
+            remove_free(next);
+            _nodes[index].size += _nodes[next].size;
+            _nodes[index].next_physical = _nodes[next].next_physical;
+            if (_nodes[next].next_physical != null_node)
+            {
+                _nodes[_nodes[next].next_physical].previous_physical = index;
+            }
+            _unused_nodes.push_back(next);
+        }
+
+        insert_free(index);
+    }
+
+    uint64_t tlsf::largest_free() const
+    {
+        if (_first_level_bitmap == 0)
+        {
+            return 0;
+        }
+
+        // blocks of the highest class aren't ordered by size
+        const auto first_level = 63 - std::countl_zero(_first_level_bitmap);
+        const auto second_level = 31 - std::countl_zero(_second_level_bitmaps[first_level]);
+        auto largest = uint64_t{ 0 };
+        for (auto index = _free_lists[first_level][second_level]; index != null_node; index = _nodes[index].next_free)
+        {
+            largest = std::max(largest, _nodes[index].size);
+        }
+        return largest;
+    }
+
+    uint32_t tlsf::create_node(uint64_t offset, uint64_t size)
+    {
+        const auto value = node{
+            .offset = offset,
+            .size = size,
+            .previous_physical = null_node,
+            .next_physical = null_node,
+            .previous_free = null_node,
+            .next_free = null_node,
+            .free = false
+        };
+
+        if (!_unused_nodes.empty())
+        {
+            const auto index = _unused_nodes.back();
+            _unused_nodes.pop_back();
+            _nodes[index] = value;
+            return index;
+        }
+
+        _nodes.push_back(value);
+        return static_cast<uint32_t>(_nodes.size() - 1);
+    }
+
+    void tlsf::insert_free(uint32_t index)
+    {
+        const auto [first_level, second_level] = classify<second_level_log2>(_nodes[index].size);
+        auto& head = _free_lists[first_level][second_level];
+
+        _nodes[index].free = true;
+        _nodes[index].previous_free = null_node;
+        _nodes[index].next_free = head;
+        if (head != null_node)
+        {
+            _nodes[head].previous_free = index;
+        }
+        head = index;
+
+        _first_level_bitmap |= uint64_t{ 1 } << first_level;
+        _second_level_bitmaps[first_level] |= 1u << second_level;
+    }
+
+    void tlsf::remove_free(uint32_t index)
+    {
+        const auto [first_level, second_level] = classify<second_level_log2>(_nodes[index].size);
+        auto& head = _free_lists[first_level][second_level];
+
+        const auto previous = _nodes[index].previous_free;
+        const auto next = _nodes[index].next_free;
+        if (previous != null_node)
+        {
+            _nodes[previous].next_free = next;
+        }
+        if (next != null_node)
+        {
+            _nodes[next].previous_free = previous;
+        }
+        if (head == index)
+        {
+            head = next;
+        }
+
+        if (head == null_node)
+        {
+            _second_level_bitmaps[first_level] &= ~(1u << second_level);
+            if (_second_level_bitmaps[first_level] == 0)
+            {
+                _first_level_bitmap &= ~(uint64_t{ 1 } << first_level);
+            }
+        }
+
+        _nodes[index].free = false;
+    }
+
+    uint32_t tlsf::split_front(uint32_t index, uint64_t size)
+    {
+        assert(size < _nodes[index].size);
+
+        const auto front = create_node(_nodes[index].offset, size);
+        _nodes[front].previous_physical = _nodes[index].previous_physical;
+        _nodes[front].next_physical = index;
+        if (_nodes[index].previous_physical != null_node)
+        {
+            _nodes[_nodes[index].previous_physical].next_physical = front;
+        }
+
+        _nodes[index].previous_physical = front;
+        _nodes[index].offset += size;
+        _nodes[index].size -= size;
+        return front;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace memory
+{
+    // Two level segregated fit over the offsets [0, capacity) of one memory block, O(1) allocate and free.
+    // Free ranges are merged with their free neighbours right away, so there's nothing to defragment later.
+    class tlsf final
+    {
+    public:
+        struct range
+        {
+            uint64_t offset;
+            // pass back to free()
+            uint32_t node;
+        };
+
+        explicit tlsf(uint64_t capacity);
+
+        // alignment has to be a power of two
+        std::optional<range> allocate(uint64_t size, uint64_t alignment);
+        void free(uint32_t node);
+
+        uint64_t capacity() const { return _capacity; }
+        uint64_t used() const { return _used; }
+        uint64_t largest_free() const;
+
+    private:
+        static constexpr auto second_level_log2 = 4u;
+        static constexpr auto second_level_count = 1u << second_level_log2;
+        static constexpr auto first_level_count = 64u;
+        static constexpr auto null_node = ~0u;
+
+        struct node
+        {
+            uint64_t offset;
+            uint64_t size;
+            uint32_t previous_physical;
+            uint32_t next_physical;
+            uint32_t previous_free;
+            uint32_t next_free;
+            bool free;
+        };
+
+        uint32_t create_node(uint64_t offset, uint64_t size);
+        void insert_free(uint32_t index);
+        void remove_free(uint32_t index);
+        // node left of offset split off from index, which keeps the rest
+        uint32_t split_front(uint32_t index, uint64_t size);
+
+        uint64_t _capacity;
+        uint64_t _used = 0;
+        std::vector<node> _nodes;
+        std::vector<uint32_t> _unused_nodes;
+        uint64_t _first_level_bitmap = 0;
+        std::array<uint32_t, first_level_count> _second_level_bitmaps = {};
+        std::array<std::array<uint32_t, second_level_count>, first_level_count> _free_lists;
+    };
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace concurrency
+{
+    // Lock-free single producer, single consumer triple buffer. The producer fills back() and publishes it, the consumer always gets the latest published slot.
+    // Neither side ever waits: the third slot is what's in between, swapped in with one atomic exchange on either side.
+    // Skipped slots are reused as they are, so T should be reusable without reallocating, e.g. vectors that keep their capacity.
+    template<typename T>
+    class triple_buffer final
+    {
+    public:
+        // producer side
+        T& back() { return _slots[_back]; }
+        void publish()
+        {
+            _back = _middle.exchange(_back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+        }
+
+        // Consumer side. Latest published slot, or the same one as last time if nothing new was published.
+        // The reference stays valid until the next call.
+        const T& latest()
+        {
+            if (_middle.load(std::memory_order_relaxed) & fresh_bit)
+            {
+                _front = _middle.exchange(_front, std::memory_order_acq_rel) & index_mask;
+            }
+
+            return _slots[_front];
+        }
+
+    private:
+        static constexpr auto index_mask = uint8_t{ 0b011 };
+        static constexpr auto fresh_bit = uint8_t{ 0b100 };
+
+        std::array<T, 3> _slots;
+        // producer and consumer indices on separate cache lines, they are written from different threads
+        alignas(64) uint8_t _back = 0;
+        alignas(64) std::atomic<uint8_t> _middle = 1;
+        alignas(64) uint8_t _front = 2;
+    };
+}